@@ -0,0 +1,352 @@
+#include <co_curl/all.hpp>
+#include <co_curl/co_curl.hpp>
+#include <co_curl/mock_transport.hpp>
+#include <co_curl/select.hpp>
+#include <co_curl/thread-pool.hpp>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+
+// cost of co_curl's coroutine machinery alone (no transfers): time and heap allocations per operation
+
+// counting allocator hook: every allocation in the process (coroutine frames included) goes through here
+static std::atomic<std::uint64_t> allocation_count{0};
+static std::atomic<std::uint64_t> allocated_bytes{0};
+
+void * operator new(std::size_t size) {
+	allocation_count.fetch_add(1u, std::memory_order_relaxed);
+	allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+	if (void * ptr = std::malloc(size != 0u ? size : 1u)) {
+		return ptr;
+	}
+
+	throw std::bad_alloc{};
+}
+
+void operator delete(void * ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void * ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+using clock_type = std::chrono::steady_clock;
+
+// coroutines parked here are suspended until released into the scheduler's ready queue, so awaiting them really
+// suspends the awaiter and their completion goes through suspend_and_schedule_next
+struct parking_lot {
+	std::vector<std::coroutine_handle<>> parked{};
+
+	struct awaiter {
+		parking_lot & lot;
+
+		bool await_ready() const noexcept { return false; }
+		void await_resume() const noexcept { }
+
+		template <typename Promise> auto await_suspend(std::coroutine_handle<Promise> h) {
+			lot.parked.push_back(h);
+			return h.promise().scheduler.suspend(h);
+		}
+	};
+
+	auto park() noexcept -> awaiter {
+		return awaiter{*this};
+	}
+
+	void release(co_curl::default_scheduler & scheduler = co_curl::get_scheduler()) {
+		for (const auto h: parked) {
+			scheduler.ready.insert(h);
+		}
+
+		parked.clear();
+	}
+};
+
+auto immediate(size_t value) -> co_curl::promise<size_t> {
+	co_return value;
+}
+
+auto parked(parking_lot & lot, size_t value) -> co_curl::promise<size_t> {
+	co_await lot.park();
+	co_return value;
+}
+
+auto wait_on(const co_curl::promise<size_t> & shared) -> co_curl::promise<size_t> {
+	co_return co_await shared;
+}
+
+auto chain(parking_lot & lot, size_t depth) -> co_curl::promise<size_t> {
+	if (depth == 0u) {
+		co_return co_await parked(lot, 1u);
+	}
+
+	co_return co_await chain(lot, depth - 1u) + 1u;
+}
+
+// each benchmark returns number of operations it did
+auto create_and_await(size_t n) -> co_curl::promise<size_t> {
+	size_t sum = 0;
+
+	for (size_t i = 0; i != n; ++i) {
+		sum += co_await immediate(i);
+	}
+
+	co_return sum != 0u ? n : 0u;
+}
+
+auto suspend_and_resume(size_t n) -> co_curl::promise<size_t> {
+	auto lot = parking_lot{};
+
+	for (size_t i = 0; i != n; ++i) {
+		auto child = parked(lot, i);
+		lot.release();
+		co_await child;
+	}
+
+	co_return n;
+}
+
+auto all_of_tasks(size_t n, size_t width) -> co_curl::promise<size_t> {
+	auto lot = parking_lot{};
+
+	for (size_t i = 0; i != n / width; ++i) {
+		std::vector<co_curl::promise<size_t>> children{};
+
+		for (size_t j = 0; j != width; ++j) {
+			children.push_back(parked(lot, j));
+		}
+
+		lot.release();
+		co_await co_curl::all(std::move(children));
+	}
+
+	co_return n / width * width;
+}
+
+auto select_of_two(size_t n) -> co_curl::promise<size_t> {
+	for (size_t i = 0; i != n; ++i) {
+		auto winner = parking_lot{};
+		auto loser = parking_lot{};
+		auto a = parked(winner, i);
+		auto b = parked(loser, i);
+
+		winner.release();
+		co_await co_curl::select(std::move(a), std::move(b));
+		// loser is destroyed while still parked
+	}
+
+	co_return n;
+}
+
+auto fan_out(size_t n, size_t width) -> co_curl::promise<size_t> {
+	auto lot = parking_lot{};
+
+	for (size_t i = 0; i != n / width; ++i) {
+		const auto shared = parked(lot, i);
+		std::vector<co_curl::promise<size_t>> waiters{};
+
+		for (size_t j = 0; j != width; ++j) {
+			waiters.push_back(wait_on(shared));
+		}
+
+		lot.release();
+
+		for (auto & w: waiters) {
+			co_await w;
+		}
+	}
+
+	co_return n / width * width;
+}
+
+auto many_tasks(size_t n) -> co_curl::promise<size_t> {
+	auto lot = parking_lot{};
+	std::vector<co_curl::promise<size_t>> children{};
+	children.reserve(n);
+
+	for (size_t i = 0; i != n; ++i) {
+		children.push_back(parked(lot, i));
+	}
+
+	lot.release();
+
+	for (auto & child: children) {
+		co_await child;
+	}
+
+	co_return n;
+}
+
+auto deep_chain(size_t depth) -> co_curl::promise<size_t> {
+	auto lot = parking_lot{};
+	auto top = chain(lot, depth);
+	lot.release();
+	co_return co_await top;
+}
+
+template <typename T> using mock_promise = co_curl::promise<T, co_curl::mock_scheduler>;
+
+auto mock_perform(co_curl::easy_handle & handle) -> mock_promise<size_t> {
+	co_return static_cast<bool>(co_await handle.perform()) ? 1u : 0u;
+}
+
+// transfers of the mock transport complete on its virtual clock without any exchange, so only scheduler's bookkeeping of
+// transfers is measured
+auto mock_transfers(size_t n, size_t width) -> mock_promise<size_t> {
+	std::vector<co_curl::easy_handle> handles{};
+
+	for (size_t j = 0; j != width; ++j) {
+		handles.emplace_back("mock://transfer");
+	}
+
+	size_t completed = 0;
+
+	for (size_t i = 0; i != n / width; ++i) {
+		std::vector<mock_promise<size_t>> transfers{};
+
+		for (co_curl::easy_handle & handle: handles) {
+			transfers.push_back(mock_perform(handle));
+		}
+
+		for (auto & t: transfers) {
+			completed += co_await t;
+		}
+	}
+
+	co_return completed;
+}
+
+auto pool_task(co_curl::thread_pool &, size_t value) -> co_curl::detached_task<size_t> {
+	co_return value;
+}
+
+auto pool_reschedule(co_curl::thread_pool &, size_t n) -> co_curl::detached_task<size_t> {
+	for (size_t i = 0; i != n; ++i) {
+		co_await co_curl::schedule_at_threadpool{};
+	}
+
+	co_return n;
+}
+
+struct result {
+	std::string name{};
+	size_t operations{0};
+	std::chrono::nanoseconds best{std::chrono::nanoseconds::max()};
+	std::uint64_t allocations{0};
+	std::uint64_t bytes{0};
+};
+
+// best of `repeat` runs: the first run after a stress test also pays for the allocator cleaning up after it
+static auto measure(std::string name, unsigned repeat, const std::function<size_t()> & run) -> result {
+	auto out = result{.name = std::move(name)};
+
+	for (unsigned r = 0; r != repeat; ++r) {
+		const auto allocations = allocation_count.load(std::memory_order_relaxed);
+		const auto bytes = allocated_bytes.load(std::memory_order_relaxed);
+		const auto start = clock_type::now();
+
+		out.operations = run();
+
+		const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start);
+		out.best = std::min(out.best, duration);
+		out.allocations = allocation_count.load(std::memory_order_relaxed) - allocations;
+		out.bytes = allocated_bytes.load(std::memory_order_relaxed) - bytes;
+	}
+
+	return out;
+}
+
+static void write_json(std::ostream & os, const std::vector<result> & results) {
+	os << R"({"benchmarks":[)";
+
+	for (bool first = true; const result & r: results) {
+		const auto ops = static_cast<double>(std::max<size_t>(r.operations, 1u));
+
+		os << (std::exchange(first, false) ? "" : ",") << "\n  ";
+		os << R"({"name":")" << r.name << R"(","operations":)" << r.operations;
+		os << R"(,"ns_per_op":)" << static_cast<double>(r.best.count()) / ops;
+		os << R"(,"allocations_per_op":)" << static_cast<double>(r.allocations) / ops;
+		os << R"(,"bytes_per_op":)" << static_cast<double>(r.bytes) / ops << '}';
+	}
+
+	os << "\n]}\n";
+}
+
+int main(int argc, char ** argv) try {
+	size_t scale = 1;
+	unsigned repeat = 3;
+	std::string output{};
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		const auto arg = std::string_view{argv[i]};
+
+		if (arg == "--scale") {
+			scale = std::stoul(argv[i + 1]);
+		} else if (arg == "--repeat") {
+			repeat = static_cast<unsigned>(std::stoul(argv[i + 1]));
+		} else if (arg == "--output") {
+			output = argv[i + 1];
+		} else {
+			throw std::invalid_argument{"unknown option " + std::string(arg)};
+		}
+	}
+
+	if (argc % 2 == 0 || scale == 0u || repeat == 0u) {
+		throw std::invalid_argument{"wrong arguments"};
+	}
+
+	const size_t n = 100'000u * scale;
+
+	// so its lazy initialization isn't measured
+	[[maybe_unused]] auto & scheduler = co_curl::get_scheduler();
+
+	std::vector<result> results{};
+
+	results.push_back(measure("create_and_await", repeat, [&] { return create_and_await(n).get(); }));
+	results.push_back(measure("suspend_and_resume", repeat, [&] { return suspend_and_resume(n).get(); }));
+	results.push_back(measure("all_of_64_per_task", repeat, [&] { return all_of_tasks(n, 64u).get(); }));
+	results.push_back(measure("select_of_two", repeat, [&] { return select_of_two(n).get(); }));
+	results.push_back(measure("fan_out_64_per_awaiter", repeat, [&] { return fan_out(n, 64u).get(); }));
+
+	// stress: all tasks suspended at once, and a chain of nested awaits like examples/lots-of-coroutines.cpp
+	results.push_back(measure("many_tasks", repeat, [&] { return many_tasks(10u * n).get(); }));
+	results.push_back(measure("deep_chain_per_level", repeat, [&] { return deep_chain(1000u * scale).get(); }));
+
+	auto & mock = co_curl::get_mock_transport();
+	mock.exchanges = false;
+	mock.respond("mock://transfer", {.latency = std::chrono::milliseconds{1}});
+
+	results.push_back(measure("mock_transfer_64_in_flight", repeat, [&] { return mock_transfers(n, 64u).get(); }));
+
+	auto pool = co_curl::thread_pool{2};
+
+	results.push_back(measure("sync_await", repeat, [&] {
+		for (size_t i = 0; i != n / 10u; ++i) {
+			co_curl::sync_await(pool_task(pool, i));
+		}
+		return n / 10u;
+	}));
+
+	results.push_back(measure("thread_pool_handoff", repeat, [&] { return co_curl::sync_await(pool_reschedule(pool, n)); }));
+
+	if (output.empty()) {
+		write_json(std::cout, results);
+	} else {
+		auto file = std::ofstream{output};
+		write_json(file, results);
+	}
+} catch (const std::exception & e) {
+	std::cerr << "usage: coroutines [--scale N] [--repeat N] [--output FILE]\n";
+	std::cerr << "error: " << e.what() << "\n";
+	return 1;
+}
@@ -0,0 +1,273 @@
+#include "loopback_server.hpp"
+#include <co_curl/all.hpp>
+#include <co_curl/co_curl.hpp>
+#include <co_curl/thread-pool.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <latch>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <sys/resource.h>
+
+// compares co_curl's ways of running transfers against an in-process HTTP/1.1 server:
+//  sync_perform  - N co_curl::promise fetchers calling easy_handle::sync_perform() (blocks the scheduler)
+//  perform_later - N co_curl::promise fetchers awaiting easy_handle::perform() (multi handle + scheduler)
+//  thread_pool   - N jobs on a thread_pool with N threads, each awaiting easy_handle::perform() (blocking)
+
+using clock_type = std::chrono::steady_clock;
+
+struct fetcher_result {
+	std::vector<std::uint64_t> latencies{}; // in nanoseconds
+	size_t errors{0};
+	size_t bytes{0};
+};
+
+struct options {
+	size_t requests{20000};
+	std::vector<size_t> concurrency{1, 8, 64};
+	size_t body_size{1024};
+	std::string output{};
+};
+
+struct measurement {
+	std::string_view path{};
+	size_t concurrency{0};
+	fetcher_result result{};
+	std::chrono::nanoseconds wall{};
+	std::chrono::nanoseconds cpu{};
+};
+
+static auto prepare(co_curl::easy_handle & handle, const std::string & url, fetcher_result & out) {
+	handle.url(url);
+
+	return [&out](std::span<const std::byte> data) {
+		out.bytes += data.size();
+	};
+}
+
+auto sync_perform_fetcher(std::string url, size_t count) -> co_curl::promise<fetcher_result> {
+	auto out = fetcher_result{};
+	out.latencies.reserve(count);
+
+	auto handle = co_curl::easy_handle{};
+	auto counter = prepare(handle, url, out);
+	handle.write_callback(counter);
+
+	for (size_t i = 0; i != count; ++i) {
+		const auto start = clock_type::now();
+
+		if (!handle.sync_perform()) {
+			++out.errors;
+		}
+
+		out.latencies.push_back(static_cast<std::uint64_t>((clock_type::now() - start).count()));
+	}
+
+	co_return out;
+}
+
+auto perform_later_fetcher(std::string url, size_t count) -> co_curl::promise<fetcher_result> {
+	auto out = fetcher_result{};
+	out.latencies.reserve(count);
+
+	auto handle = co_curl::easy_handle{};
+	auto counter = prepare(handle, url, out);
+	handle.write_callback(counter);
+
+	for (size_t i = 0; i != count; ++i) {
+		const auto start = clock_type::now();
+
+		if (!co_await handle.perform()) {
+			++out.errors;
+		}
+
+		out.latencies.push_back(static_cast<std::uint64_t>((clock_type::now() - start).count()));
+	}
+
+	co_return out;
+}
+
+auto thread_pool_fetcher(co_curl::thread_pool &, std::string url, size_t count, fetcher_result & out, std::latch & done) -> co_curl::pool_job {
+	out.latencies.reserve(count);
+
+	auto handle = co_curl::easy_handle{};
+	auto counter = prepare(handle, url, out);
+	handle.write_callback(counter);
+
+	for (size_t i = 0; i != count; ++i) {
+		const auto start = clock_type::now();
+
+		// outside of co_curl::promise this is a blocking sync_perform on the pool's thread
+		if (!co_await handle.perform()) {
+			++out.errors;
+		}
+
+		out.latencies.push_back(static_cast<std::uint64_t>((clock_type::now() - start).count()));
+	}
+
+	done.count_down();
+}
+
+static auto merge(std::vector<fetcher_result> && results) -> fetcher_result {
+	auto out = fetcher_result{};
+
+	for (fetcher_result & r: results) {
+		out.latencies.insert(out.latencies.end(), r.latencies.begin(), r.latencies.end());
+		out.errors += r.errors;
+		out.bytes += r.bytes;
+	}
+
+	return out;
+}
+
+static auto run_coroutines(auto fetcher, const std::string & url, size_t concurrency, size_t per_fetcher) -> fetcher_result {
+	std::vector<co_curl::promise<fetcher_result>> fetchers{};
+
+	for (size_t i = 0; i != concurrency; ++i) {
+		fetchers.push_back(fetcher(url, per_fetcher));
+	}
+
+	std::vector<fetcher_result> results = co_curl::all(std::move(fetchers));
+	return merge(std::move(results));
+}
+
+static auto run_thread_pool(const std::string & url, size_t concurrency, size_t per_fetcher) -> fetcher_result {
+	auto results = std::vector<fetcher_result>(concurrency);
+	auto done = std::latch{static_cast<std::ptrdiff_t>(concurrency)};
+	auto pool = co_curl::thread_pool{concurrency};
+
+	for (fetcher_result & r: results) {
+		thread_pool_fetcher(pool, url, per_fetcher, r, done);
+	}
+
+	done.wait();
+	return merge(std::move(results));
+}
+
+static auto process_cpu_time() -> std::chrono::nanoseconds {
+	rusage usage{};
+	::getrusage(RUSAGE_SELF, &usage);
+
+	const auto to_ns = [](timeval tv) { return std::chrono::seconds{tv.tv_sec} + std::chrono::microseconds{tv.tv_usec}; };
+	return to_ns(usage.ru_utime) + to_ns(usage.ru_stime);
+}
+
+static auto measure(std::string_view path, loopback_server & server, size_t concurrency, size_t requests, auto && run) -> measurement {
+	const auto per_fetcher = std::max<size_t>(requests / concurrency, 1u);
+
+	const auto cpu_start = process_cpu_time() - server.cpu_time();
+	const auto wall_start = clock_type::now();
+
+	auto result = run(server.url(), concurrency, per_fetcher);
+
+	const auto wall = clock_type::now() - wall_start;
+	const auto cpu = process_cpu_time() - server.cpu_time() - cpu_start;
+
+	return measurement{.path = path, .concurrency = concurrency, .result = std::move(result), .wall = wall, .cpu = cpu};
+}
+
+static auto percentile(const std::vector<std::uint64_t> & sorted, double p) -> double {
+	if (sorted.empty()) {
+		return 0.0;
+	}
+
+	// nearest rank
+	const auto rank = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size()) + 0.5);
+	return static_cast<double>(sorted[std::clamp<size_t>(rank, 1u, sorted.size()) - 1u]) / 1000.0;
+}
+
+static void write_json(std::ostream & os, const options & opts, std::vector<measurement> & results) {
+	os << R"({"server":"http/1.1 loopback","body_size":)" << opts.body_size << R"(,"results":[)";
+
+	for (bool first = true; measurement & m: results) {
+		auto & latencies = m.result.latencies;
+		std::ranges::sort(latencies);
+
+		const auto requests = latencies.size();
+		const auto seconds = std::chrono::duration<double>(m.wall).count();
+		const auto cpu_us = std::chrono::duration<double, std::micro>(m.cpu).count();
+
+		os << (std::exchange(first, false) ? "" : ",") << "\n  ";
+		os << R"({"path":")" << m.path << R"(","concurrency":)" << m.concurrency << R"(,"requests":)" << requests;
+		os << R"(,"errors":)" << m.result.errors << R"(,"bytes":)" << m.result.bytes << R"(,"seconds":)" << seconds;
+		os << R"(,"requests_per_second":)" << (seconds > 0.0 ? static_cast<double>(requests) / seconds : 0.0);
+		os << R"(,"latency_us":{"p50":)" << percentile(latencies, 50.0) << R"(,"p90":)" << percentile(latencies, 90.0);
+		os << R"(,"p99":)" << percentile(latencies, 99.0) << R"(,"p999":)" << percentile(latencies, 99.9);
+		os << R"(,"max":)" << percentile(latencies, 100.0) << '}';
+		os << R"(,"cpu_us_per_request":)" << (requests != 0u ? cpu_us / static_cast<double>(requests) : 0.0) << '}';
+	}
+
+	os << "\n]}\n";
+}
+
+static auto parse_list(std::string_view in) -> std::vector<size_t> {
+	std::vector<size_t> out{};
+	auto ss = std::istringstream{std::string(in)};
+
+	for (std::string item; std::getline(ss, item, ',');) {
+		out.push_back(std::stoul(item));
+	}
+
+	return out;
+}
+
+static auto parse_options(int argc, char ** argv) -> options {
+	auto out = options{};
+
+	for (int i = 1; i < argc; ++i) {
+		const auto arg = std::string_view{argv[i]};
+
+		if (i + 1 == argc) {
+			throw std::invalid_argument{"missing value for " + std::string(arg)};
+		}
+
+		const auto value = std::string_view{argv[++i]};
+
+		if (arg == "--requests") {
+			out.requests = std::stoul(std::string(value));
+		} else if (arg == "--concurrency") {
+			out.concurrency = parse_list(value);
+		} else if (arg == "--body") {
+			out.body_size = std::stoul(std::string(value));
+		} else if (arg == "--output") {
+			out.output = value;
+		} else {
+			throw std::invalid_argument{"unknown option " + std::string(arg)};
+		}
+	}
+
+	if (std::ranges::find(out.concurrency, 0u) != out.concurrency.end()) {
+		throw std::invalid_argument{"concurrency must be positive"};
+	}
+
+	return out;
+}
+
+int main(int argc, char ** argv) try {
+	const auto opts = parse_options(argc, argv);
+
+	auto server = loopback_server{opts.body_size};
+	std::vector<measurement> results{};
+
+	for (const size_t concurrency: opts.concurrency) {
+		results.push_back(measure("sync_perform", server, concurrency, opts.requests, [](const std::string & url, size_t n, size_t per_fetcher) { return run_coroutines(sync_perform_fetcher, url, n, per_fetcher); }));
+		results.push_back(measure("perform_later", server, concurrency, opts.requests, [](const std::string & url, size_t n, size_t per_fetcher) { return run_coroutines(perform_later_fetcher, url, n, per_fetcher); }));
+		results.push_back(measure("thread_pool", server, concurrency, opts.requests, run_thread_pool));
+	}
+
+	if (opts.output.empty()) {
+		write_json(std::cout, opts, results);
+	} else {
+		auto file = std::ofstream{opts.output};
+		write_json(file, opts, results);
+	}
+} catch (const std::exception & e) {
+	std::cerr << "usage: loopback [--requests N] [--concurrency N,M,...] [--body BYTES] [--output FILE]\n";
+	std::cerr << "error: " << e.what() << "\n";
+	return 1;
+}
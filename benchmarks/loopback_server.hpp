@@ -0,0 +1,204 @@
+#ifndef CO_CURL_BENCHMARKS_LOOPBACK_SERVER_HPP
+#define CO_CURL_BENCHMARKS_LOOPBACK_SERVER_HPP
+
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// minimal HTTP/1.1 server on 127.0.0.1 running in its own thread, every request gets the same response
+// (keep-alive and pipelining are supported, request bodies are not)
+struct loopback_server {
+	struct connection {
+		int fd{-1};
+		std::string input{};
+		std::string output{};
+		size_t written{0};
+	};
+
+	std::string response{};
+	int listener{-1};
+	int stop_pipe[2]{-1, -1};
+	std::uint16_t port{0};
+	std::vector<connection> connections{};
+	std::thread thread{};
+
+	explicit loopback_server(size_t body_size) {
+		response = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: " + std::to_string(body_size) + "\r\n\r\n";
+		response.append(body_size, 'x');
+
+		listener = check(::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+
+		const int yes = 1;
+		::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = 0; // any free port
+
+		check(::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)));
+		check(::listen(listener, SOMAXCONN));
+
+		socklen_t length = sizeof(address);
+		check(::getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length));
+		port = ntohs(address.sin_port);
+
+		check(::pipe2(stop_pipe, O_CLOEXEC));
+
+		thread = std::thread([this] { run(); });
+	}
+
+	loopback_server(const loopback_server &) = delete;
+	loopback_server(loopback_server &&) = delete;
+
+	~loopback_server() noexcept {
+		[[maybe_unused]] const auto r = ::write(stop_pipe[1], "x", 1);
+		thread.join();
+
+		for (const connection & c: connections) {
+			::close(c.fd);
+		}
+
+		::close(listener);
+		::close(stop_pipe[0]);
+		::close(stop_pipe[1]);
+	}
+
+	auto url(std::string_view path = "/") const -> std::string {
+		return "http://127.0.0.1:" + std::to_string(port) + std::string(path);
+	}
+
+	// CPU time consumed by the server thread (so it can be subtracted from the whole process)
+	auto cpu_time() const -> std::chrono::nanoseconds {
+		clockid_t clock{};
+
+		if (::pthread_getcpuclockid(const_cast<std::thread &>(thread).native_handle(), &clock) != 0) {
+			return {};
+		}
+
+		timespec ts{};
+		::clock_gettime(clock, &ts);
+		return std::chrono::seconds{ts.tv_sec} + std::chrono::nanoseconds{ts.tv_nsec};
+	}
+
+	// internals
+	static int check(int r) {
+		if (r < 0) {
+			throw std::system_error{errno, std::generic_category(), "loopback_server"};
+		}
+
+		return r;
+	}
+
+	void run() {
+		std::vector<pollfd> fds{};
+
+		for (;;) {
+			fds.clear();
+			fds.push_back({.fd = stop_pipe[0], .events = POLLIN, .revents = 0});
+			fds.push_back({.fd = listener, .events = POLLIN, .revents = 0});
+
+			for (const connection & c: connections) {
+				fds.push_back({.fd = c.fd, .events = static_cast<short>(c.output.size() != c.written ? POLLOUT : POLLIN), .revents = 0});
+			}
+
+			if (::poll(fds.data(), fds.size(), -1) < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+
+				return;
+			}
+
+			if (fds[0].revents != 0) {
+				return;
+			}
+
+			// iterate over connections from previous round only, accepted ones are appended
+			const size_t count = connections.size();
+
+			for (size_t i = count; i != 0; --i) {
+				const size_t index = i - 1u;
+
+				if (fds[index + 2u].revents != 0 && !serve(connections[index])) {
+					::close(connections[index].fd);
+					connections.erase(connections.begin() + static_cast<std::ptrdiff_t>(index));
+				}
+			}
+
+			if (fds[1].revents != 0) {
+				accept_all();
+			}
+		}
+	}
+
+	void accept_all() {
+		for (;;) {
+			const int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+			if (fd < 0) {
+				return;
+			}
+
+			const int yes = 1;
+			::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+			connections.push_back(connection{.fd = fd});
+		}
+	}
+
+	// false when the connection should be closed
+	bool serve(connection & c) {
+		if (c.output.size() == c.written) {
+			char buffer[16 * 1024];
+			const auto r = ::recv(c.fd, buffer, sizeof(buffer), 0);
+
+			if (r == 0) {
+				return false;
+			} else if (r < 0) {
+				return errno == EAGAIN || errno == EINTR;
+			}
+
+			c.input.append(buffer, static_cast<size_t>(r));
+			c.output.clear();
+			c.written = 0;
+
+			// answer all complete requests (they can be pipelined)
+			size_t consumed = 0;
+
+			for (size_t end; (end = c.input.find("\r\n\r\n", consumed)) != std::string::npos; consumed = end + 4u) {
+				c.output.append(response);
+			}
+
+			c.input.erase(0, consumed);
+		}
+
+		while (c.written != c.output.size()) {
+			const auto r = ::send(c.fd, c.output.data() + c.written, c.output.size() - c.written, MSG_NOSIGNAL);
+
+			if (r < 0) {
+				return errno == EAGAIN || errno == EINTR;
+			}
+
+			c.written += static_cast<size_t>(r);
+		}
+
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/format.hpp>
+#include <vector>
+#include <chrono>
+
+auto download(std::string url, std::string group, double weight) -> co_curl::promise<size_t> {
+	auto handle = co_curl::easy_handle{url};
+
+	size_t size = 0;
+	auto count = [&](std::span<const std::byte> data) { size += data.size(); };
+	handle.write_callback(count);
+
+	// shares of transfers in the same group are proportional to their weights
+	co_curl::get_scheduler().get_bandwidth().assign(handle, group, weight);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	if (!co_await handle.perform()) {
+		throw std::runtime_error{"unable to download " + url};
+	}
+
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << group << " (weight " << weight << "): " << co_curl::data_amount(size) << " in " << seconds << " s\n";
+
+	co_return size;
+}
+
+auto download_all(std::string url) -> co_curl::promise<size_t> {
+	std::vector<co_curl::promise<size_t>> transfers{};
+
+	transfers.push_back(download(url, "background", 1.0));
+	transfers.push_back(download(url, "interactive", 1.0));
+	transfers.push_back(download(url, "interactive", 3.0));
+
+	size_t total = 0;
+
+	for (auto & t: transfers) {
+		total += co_await t;
+	}
+
+	co_return total;
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: bandwidth URL [BYTES-PER-SECOND]\n";
+		return 1;
+	}
+
+	auto & bandwidth = co_curl::get_scheduler().get_bandwidth();
+	bandwidth.enabled = true;
+	bandwidth.global.recv = (argc > 2) ? std::stoul(argv[2]) : 1024u * 1024u;
+
+	// interactive transfers get three quarters of the budget while both groups are downloading
+	bandwidth.set_group("background", {}, 1.0);
+	bandwidth.set_group("interactive", {}, 3.0);
+
+	const size_t total = download_all(argv[1]);
+
+	std::cout << "downloaded " << co_curl::data_amount(total) << "\n";
+}
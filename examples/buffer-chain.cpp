@@ -0,0 +1,24 @@
+#include <co_curl/fetch.hpp>
+#include <co_curl/format.hpp>
+#include <unistd.h>
+
+auto download(std::string url) -> co_curl::promise<co_curl::buffer_chain> {
+	// body is stored in pooled segments, no reallocation while downloading
+	co_return co_await co_curl::fetch<co_curl::buffer_chain>(url);
+}
+
+int main(int argc, char ** argv) {
+	if (argc != 2) {
+		std::cerr << "usage: buffer-chain URL\n";
+		return 1;
+	}
+
+	const co_curl::buffer_chain body = download(argv[1]).get();
+
+	std::cerr << "downloaded " << co_curl::data_amount(body.size()) << " in " << body.segments.size() << " segments\n";
+
+	if (!body.write_to(STDOUT_FILENO)) {
+		std::cerr << "unable to write output\n";
+		return 1;
+	}
+}
@@ -0,0 +1,18 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/disk_cache.hpp>
+#include <co_curl/format.hpp>
+
+int main(int argc, char ** argv) {
+	if (argc != 3) {
+		std::cerr << "usage: disk-cache DIRECTORY URL\n";
+		return 1;
+	}
+
+	// index and bodies survive the process, next run is served from the disk
+	auto cache = co_curl::disk_cache{argv[1]};
+
+	const co_curl::cached_body body = co_curl::fetch(cache, argv[2]);
+
+	std::cout << "received " << co_curl::data_amount(body.size()) << (body.from_cache ? " (from cache)" : "") << "\n";
+	std::cout << "hits: " << cache.stats.hits << ", revalidated: " << cache.stats.revalidated << ", misses: " << cache.stats.misses << "\n";
+}
@@ -0,0 +1,40 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/file_sink.hpp>
+#include <co_curl/format.hpp>
+
+auto download(co_curl::thread_pool & pool, std::string url, std::filesystem::path path, unsigned attempts = 5) -> co_curl::promise<size_t> {
+	auto handle = co_curl::easy_handle{url};
+	auto sink = co_curl::file_sink{pool, path};
+
+	// writes to the disk are done by the thread_pool, file is preallocated from Content-Length
+	sink.attach(handle);
+	handle.follow_location();
+
+	for (;;) {
+		if (co_await handle.perform()) {
+			break;
+		}
+
+		if (attempts-- == 0u) {
+			throw std::runtime_error{"unable to download requested document"};
+		}
+
+		// keep what was already written
+		handle.resume(sink.size());
+	}
+
+	sink.flush();
+	co_return sink.size();
+}
+
+int main(int argc, char ** argv) {
+	if (argc != 3) {
+		std::cerr << "usage: download-to-file URL FILENAME\n";
+		return 1;
+	}
+
+	auto pool = co_curl::thread_pool{1};
+
+	const size_t size = download(pool, argv[1], argv[2]);
+	std::cout << "downloaded " << co_curl::data_amount(size) << "\n";
+}
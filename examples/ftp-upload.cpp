@@ -1,34 +1,8 @@
 #include <co_curl/co_curl.hpp>
+#include <co_curl/file_source.hpp>
 #include <co_curl/format.hpp>
 #include <exception>
 #include <filesystem>
-#include <fstream>
-#include <iterator>
-
-auto load_file(std::filesystem::path path) -> co_curl::promise<std::vector<char>> {
-	std::cout << "Loading file '" << path << "'...\n";
-
-	auto stream = std::ifstream{path, std::ios::binary};
-
-	if (!stream) {
-		throw std::runtime_error("Can't open file");
-	}
-
-	stream.unsetf(std::ios::skipws);
-
-	stream.seekg(0, std::ios::end);
-	std::streampos size = stream.tellg();
-	stream.seekg(0, std::ios::beg);
-
-	// reserve capacity
-	std::vector<char> output;
-	output.reserve(static_cast<size_t>(size));
-
-	// read the data:
-	output.insert(output.begin(), std::istream_iterator<char>(stream), std::istream_iterator<char>());
-
-	co_return output;
-}
 
 auto upload(std::string name, std::string url, std::string username, std::string password, std::filesystem::path filepath) -> co_curl::promise<bool> {
 	auto postquote = co_curl::list{};
@@ -37,9 +11,8 @@ auto upload(std::string name, std::string url, std::string username, std::string
 
 	auto handle = co_curl::easy_handle{};
 
-	std::string output;
-
-	const std::vector<char> filedata = co_await load_file(filepath);
+	// file is memory mapped and streamed directly into curl's buffer
+	auto source = co_curl::file_source{filepath};
 
 	// handle.verbose();
 	handle.url(url + "temporary.bin");
@@ -47,22 +20,9 @@ auto upload(std::string name, std::string url, std::string username, std::string
 	handle.password(password.c_str());
 	handle.upload();
 	handle.postquote(postquote);
-	handle.infile_size(filedata.size());
-
-	auto reader = [content = std::span(filedata)](std::span<char> target) mutable -> size_t {
-		const auto common_length = std::min(target.size(), content.size());
-
-		const auto source = content.first(common_length);
-
-		std::copy(source.begin(), source.end(), target.begin());
-
-		content = content.subspan(common_length);
-		return common_length;
-	};
-
-	handle.read_callback(reader);
+	source.attach(handle);
 
-	std::cout << "Uploading '" << name << "' to '" << url << "'... (size = " << co_curl::data_amount(filedata.size()) << ")\n";
+	std::cout << "Uploading '" << name << "' to '" << url << "'... (size = " << co_curl::data_amount(source.size()) << ")\n";
 
 	const co_curl::result r = co_await handle.perform();
 
@@ -0,0 +1,35 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/hedged_fetch.hpp>
+#include <chrono>
+
+auto fetch_many_times(co_curl::hedge_policy & policy, std::string url, std::string backup, unsigned count) -> co_curl::promise<std::chrono::milliseconds> {
+	auto slowest = std::chrono::milliseconds{0};
+
+	for (unsigned i = 0; i != count; ++i) {
+		const auto started = std::chrono::steady_clock::now();
+
+		// slow responses are cut short by a backup transfer
+		(void)co_await co_curl::hedged_fetch(url, policy, backup);
+
+		slowest = std::max(slowest, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started));
+	}
+
+	co_return slowest;
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: hedged-fetch URL [BACKUP-URL] [COUNT]\n";
+		return 1;
+	}
+
+	auto policy = co_curl::hedge_policy{};
+
+	const std::chrono::milliseconds slowest = fetch_many_times(policy, argv[1], argc > 2 ? argv[2] : "", argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 100u);
+
+	const auto p50 = policy.latencies.percentile(0.5).value_or(std::chrono::microseconds{0});
+	const auto p95 = policy.latencies.percentile(0.95).value_or(std::chrono::microseconds{0});
+
+	std::cout << "requests: " << policy.requests << ", hedged: " << policy.hedges << ", backup won: " << policy.backup_wins << "\n";
+	std::cout << "p50: " << p50.count() << "us, p95: " << p95.count() << "us, slowest: " << slowest.count() << "ms\n";
+}
@@ -0,0 +1,63 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/metrics.hpp>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+auto fetch(std::string url, bool heavy) -> co_curl::promise<size_t> {
+	if (heavy) {
+		co_await co_curl::label("heavy parser");
+	}
+
+	auto handle = co_curl::easy_handle{url};
+
+	std::string output;
+	handle.write_into(output);
+
+	if (!co_await handle.perform()) {
+		co_return 0u;
+	}
+
+	if (heavy) {
+		// pretend expensive parsing, all other transfers and coroutines wait for it
+		std::this_thread::sleep_for(std::chrono::milliseconds{50});
+	}
+
+	co_return output.size();
+}
+
+auto fetch_all(std::string url) -> co_curl::promise<size_t> {
+	std::vector<co_curl::promise<size_t>> transfers{};
+
+	for (unsigned i = 0; i != 10u; ++i) {
+		transfers.push_back(fetch(url, i == 3u));
+	}
+
+	size_t total = 0;
+
+	for (auto & t: transfers) {
+		total += co_await t;
+	}
+
+	co_return total;
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: loop-lag URL\n";
+		return 1;
+	}
+
+	auto & lag = co_curl::get_scheduler().get_loop_lag();
+	lag.enabled = true;
+	lag.threshold = std::chrono::milliseconds{20};
+
+	const size_t total = fetch_all(argv[1]);
+	std::cout << "downloaded " << total << " bytes\n";
+
+	const auto & metrics = co_curl::get_scheduler().get_metrics();
+
+	if (const auto p99 = metrics.loop_lag.percentile(0.99)) {
+		std::cout << "slices: " << metrics.loop_lag.count() << ", p99: " << p99->count() << " us, slow: " << metrics.slow_slices.get() << "\n";
+	}
+}
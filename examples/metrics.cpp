@@ -0,0 +1,45 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/metrics.hpp>
+#include <vector>
+
+auto fetch(std::string url) -> co_curl::promise<size_t> {
+	auto handle = co_curl::easy_handle{url};
+
+	std::string output;
+	handle.write_into(output);
+
+	if (!co_await handle.perform()) {
+		co_return 0u;
+	}
+
+	co_return output.size();
+}
+
+auto fetch_all(std::string url, unsigned count) -> co_curl::promise<size_t> {
+	std::vector<co_curl::promise<size_t>> transfers{};
+
+	for (unsigned i = 0; i != count; ++i) {
+		transfers.push_back(fetch(url));
+	}
+
+	size_t total = 0;
+
+	for (auto & t: transfers) {
+		total += co_await t;
+	}
+
+	co_return total;
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: metrics URL [COUNT]\n";
+		return 1;
+	}
+
+	const size_t total = fetch_all(argv[1], (argc > 2) ? static_cast<unsigned>(std::stoul(argv[2])) : 20u);
+	std::cerr << "downloaded " << total << " bytes\n";
+
+	// what a /metrics endpoint would serve
+	std::cout << co_curl::render_prometheus(co_curl::get_scheduler().get_metrics());
+}
@@ -0,0 +1,32 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/format.hpp>
+#include <co_curl/mirror_set.hpp>
+
+auto fetch_many_times(co_curl::mirror_set & mirrors, std::string path, unsigned count) -> co_curl::promise<size_t> {
+	size_t total = 0;
+
+	for (unsigned i = 0; i != count; ++i) {
+		// mirrors which fail or are slow are chosen less often
+		const std::string body = co_await co_curl::parallel_fetch(mirrors, path);
+		total += body.size();
+	}
+
+	co_return total;
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 3) {
+		std::cerr << "usage: mirrors PATH BASE-URL...\n";
+		return 1;
+	}
+
+	auto mirrors = co_curl::mirror_set{std::vector<std::string>(argv + 2, argv + argc)};
+
+	const size_t total = fetch_many_times(mirrors, argv[1], 20u);
+
+	std::cout << "downloaded " << co_curl::data_amount(total) << "\n";
+
+	for (const co_curl::mirror & m: mirrors.mirrors) {
+		std::cout << m.base << ": latency " << m.latency_ms << " ms, errors " << m.error_rate * 100.0 << " %\n";
+	}
+}
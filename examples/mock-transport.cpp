@@ -0,0 +1,82 @@
+#include <co_curl/fetch.hpp>
+#include <co_curl/mock_transport.hpp>
+#include <co_curl/select.hpp>
+#include <iostream>
+
+// everything runs against scripted responses on a virtual clock, so output is always the same (and instant)
+
+using namespace std::chrono_literals;
+
+template <typename T> using mock_promise = co_curl::promise<T, co_curl::mock_scheduler>;
+
+static auto elapsed() -> long long {
+	static const auto start = co_curl::get_mock_transport().now();
+	return std::chrono::duration_cast<std::chrono::milliseconds>(co_curl::get_mock_transport().now() - start).count();
+}
+
+auto download(std::string url) -> mock_promise<std::string> {
+	auto handle = co_curl::easy_handle{url};
+
+	std::string output;
+	size_t chunks = 0;
+
+	auto collect = [&](std::string_view data) {
+		output.append(data);
+		++chunks;
+	};
+
+	handle.write_callback<std::string_view>(collect);
+
+	const auto r = co_await handle.perform();
+
+	std::cout << "[" << elapsed() << "ms] " << url << ": " << (r ? std::to_string(handle.get_response_code()) : std::string(r.c_str())) << ", " << chunks << " chunks\n";
+
+	co_return output;
+}
+
+auto main_coroutine() -> mock_promise<int> {
+	(void)elapsed();
+
+	// completed in order of their latency, not start
+	const auto a = download("https://example.com/slow");
+	const auto b = download("https://example.com/fast");
+	const auto c = download("https://example.com/chunked");
+	const auto d = download("https://example.com/missing");
+
+	co_await a;
+	co_await b;
+	co_await c;
+	co_await d;
+
+	// loser is destroyed and its transfer removed, so select finishes with the fast one
+	const auto winner = co_await co_curl::select(download("https://example.com/slow"), download("https://example.com/fast"));
+	std::cout << "[" << elapsed() << "ms] select: '" << winner << "'\n";
+
+	// two 503s with Retry-After are retried by fetch, sleeps between attempts take no real time
+	auto policy = co_curl::retry_policy{.max_attempts = 5};
+	const auto body = co_await co_curl::fetch<std::string, co_curl::mock_scheduler>("https://example.com/flaky", policy);
+	std::cout << "[" << elapsed() << "ms] flaky: '" << body << "'\n";
+
+	co_return 0;
+}
+
+int main() {
+	auto & mock = co_curl::get_mock_transport();
+
+	mock.respond("https://example.com/slow", {.body = "slow", .latency = 300ms});
+	mock.respond("https://example.com/fast", {.body = "fast", .latency = 20ms});
+	mock.respond("https://example.com/chunked", {.body = "lorem ipsum dolor sit amet", .latency = 100ms, .chunk_size = 5});
+	mock.respond("https://example.com/flaky", {.status = 503, .headers = {{"Retry-After", "1"}}, .latency = 50ms});
+	mock.respond("https://example.com/flaky", {.status = 503, .headers = {{"Retry-After", "2"}}, .latency = 50ms});
+	mock.respond("https://example.com/flaky", {.body = "finally", .latency = 50ms});
+
+	const int r = main_coroutine();
+
+	std::cout << "requests:\n";
+
+	for (const auto & request: mock.requests) {
+		std::cout << "  " << request.url << "\n";
+	}
+
+	return r;
+}
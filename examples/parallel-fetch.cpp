@@ -0,0 +1,15 @@
+#include <co_curl/format.hpp>
+#include <co_curl/parallel_fetch.hpp>
+
+int main(int argc, char ** argv) {
+	if (argc != 3) {
+		std::cerr << "usage: parallel-fetch URL FILENAME\n";
+		return 1;
+	}
+
+	auto pool = co_curl::thread_pool{1};
+
+	// size is probed first, then 8 ranges are downloaded concurrently, each retried on its own
+	const size_t size = co_curl::parallel_fetch(argv[1], pool, argv[2], 8);
+	std::cout << "downloaded " << co_curl::data_amount(size) << "\n";
+}
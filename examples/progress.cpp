@@ -0,0 +1,56 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/format.hpp>
+#include <co_curl/progress.hpp>
+
+auto show(co_curl::progress_stream & stream) -> co_curl::promise<void> {
+	while (const auto p = co_await stream.next()) {
+		std::cout << co_curl::data_amount(p->downloaded);
+
+		if (p->download_total != 0u) {
+			std::cout << " of " << co_curl::data_amount(p->download_total);
+		}
+
+		std::cout << " (" << co_curl::data_amount(static_cast<size_t>(p->download_speed)) << "/s)\n";
+	}
+}
+
+auto download(std::string url) -> co_curl::promise<size_t> {
+	auto handle = co_curl::easy_handle{url};
+
+	size_t size = 0;
+	auto count = [&](std::span<const std::byte> data) { size += data.size(); };
+	handle.write_callback(count);
+
+	// abort when less than 16 KiB/s is transferred for two seconds
+	auto stream = co_curl::progress_stream{handle, std::chrono::milliseconds{500}, co_curl::stall_policy{.min_speed = 16u * 1024u, .window = std::chrono::seconds{2}}};
+
+	auto display = show(stream);
+
+	const auto r = co_await handle.perform();
+	co_await display;
+
+	if (r.is_aborted_by_callback()) {
+		throw std::runtime_error{"transfer of " + url + " stalled"};
+	}
+
+	if (!r) {
+		throw std::runtime_error{"unable to download " + url};
+	}
+
+	co_return size;
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: progress URL\n";
+		return 1;
+	}
+
+	try {
+		const size_t size = download(argv[1]);
+		std::cout << "downloaded " << co_curl::data_amount(size) << "\n";
+	} catch (const std::exception & e) {
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+}
@@ -0,0 +1,108 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/replay_transport.hpp>
+#include <iostream>
+#include <vector>
+
+// record: downloads all URLs at once with the default scheduler and saves exchanges into FILE
+// replay: starts the recorded transfers at their recorded times against responses from FILE (both scaled by SPEED)
+
+using clock_type = std::chrono::steady_clock;
+
+template <typename T> using replay_promise = co_curl::promise<T, co_curl::replay_scheduler>;
+
+auto download(std::string url) -> co_curl::promise<size_t> {
+	auto handle = co_curl::easy_handle{url};
+
+	size_t bytes = 0;
+	auto count = [&](std::span<const std::byte> data) { bytes += data.size(); };
+
+	handle.follow_location();
+	handle.write_callback(count);
+
+	const auto r = co_await handle.perform();
+	std::cout << url << ": " << (r ? std::to_string(handle.get_response_code()) : std::string(r.c_str())) << ", " << bytes << " bytes\n";
+
+	co_return bytes;
+}
+
+auto record(std::vector<std::string> urls) -> co_curl::promise<co_curl::recording> {
+	auto & recorder = co_curl::get_scheduler().get_recorder();
+	recorder.start();
+
+	std::vector<co_curl::promise<size_t>> downloads{};
+
+	for (const std::string & url: urls) {
+		downloads.push_back(download(url));
+	}
+
+	for (auto & d: downloads) {
+		co_await d;
+	}
+
+	co_return recorder.stop();
+}
+
+auto replay_one(co_curl::recorded_transfer transfer, clock_type::time_point start, double speed) -> replay_promise<int> {
+	co_await co_curl::sleep_until(start + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double, std::micro>(transfer.started) / speed));
+
+	auto handle = co_curl::easy_handle{transfer.url};
+
+	size_t bytes = 0;
+	auto count = [&](std::span<const std::byte> data) { bytes += data.size(); };
+
+	handle.follow_location();
+	handle.write_callback(count);
+
+	const auto request = clock_type::now();
+	const auto r = co_await handle.perform();
+	const auto took = std::chrono::duration_cast<std::chrono::milliseconds>(clock_type::now() - request);
+
+	std::cout << transfer.url << ": " << (r ? std::to_string(handle.get_response_code()) : std::string(r.c_str())) << ", " << bytes << " bytes in " << took.count() << "ms\n";
+
+	co_return r.code;
+}
+
+auto replay(const co_curl::recording & recording, double speed) -> replay_promise<int> {
+	co_curl::get_replay_transport().load(recording, speed);
+
+	const auto start = clock_type::now();
+	std::vector<replay_promise<int>> transfers{};
+
+	for (const co_curl::recorded_transfer & t: recording.transfers) {
+		transfers.push_back(replay_one(t, start, speed));
+	}
+
+	for (auto & t: transfers) {
+		co_await t;
+	}
+
+	co_return 0;
+}
+
+int main(int argc, char ** argv) {
+	const auto mode = std::string_view{argc > 2 ? argv[1] : ""};
+
+	if (mode == "record" && argc > 3) {
+		const co_curl::recording r = record(std::vector<std::string>(argv + 3, argv + argc));
+		r.save(argv[2]);
+
+		size_t chunks = 0;
+
+		for (const auto & t: r.transfers) {
+			for (const auto & response: t.responses) {
+				chunks += response.body.size();
+			}
+		}
+
+		std::cout << "recorded " << r.transfers.size() << " transfers (" << chunks << " body pieces) into " << argv[2] << "\n";
+		return 0;
+	}
+
+	if (mode == "replay") {
+		return replay(co_curl::recording::load(argv[2]), argc > 3 ? std::stod(argv[3]) : 1.0);
+	}
+
+	std::cerr << "usage: record-replay record FILE URL...\n";
+	std::cerr << "       record-replay replay FILE [SPEED]\n";
+	return 1;
+}
@@ -0,0 +1,28 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/response_cache.hpp>
+
+auto fetch_repeatedly(co_curl::response_cache & cache, std::string url, unsigned count) -> co_curl::promise<size_t> {
+	size_t total = 0;
+
+	for (unsigned i = 0; i != count; ++i) {
+		// first is a miss, then it's served from memory or revalidated with 304
+		const std::string body = co_await co_curl::fetch(cache, url);
+		total += body.size();
+	}
+
+	co_return total;
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: response-cache URL [COUNT]\n";
+		return 1;
+	}
+
+	auto cache = co_curl::response_cache{};
+
+	const size_t total = fetch_repeatedly(cache, argv[1], argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 3u);
+
+	std::cout << "received " << total << " bytes\n";
+	std::cout << "hits: " << cache.stats.hits << ", revalidated: " << cache.stats.revalidated << ", misses: " << cache.stats.misses << "\n";
+}
@@ -0,0 +1,31 @@
+#include <co_curl/all.hpp>
+#include <co_curl/co_curl.hpp>
+#include <co_curl/singleflight.hpp>
+#include <vector>
+
+auto fetch_many_times(co_curl::singleflight<std::string> & flights, std::string url, unsigned count) -> co_curl::promise<std::vector<std::string>> {
+	// all of them ask at once, but only one transfer is made
+	auto fetches = std::vector<co_curl::promise<std::string>>{};
+
+	for (unsigned i = 0; i != count; ++i) {
+		fetches.emplace_back(co_curl::fetch(flights, url));
+	}
+
+	co_return co_await co_curl::all(std::move(fetches));
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: singleflight URL [COUNT]\n";
+		return 1;
+	}
+
+	const unsigned count = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 10u;
+
+	auto flights = co_curl::singleflight<std::string>{};
+
+	const std::vector<std::string> bodies = fetch_many_times(flights, argv[1], count);
+
+	std::cout << "received " << bodies.size() << " bodies\n";
+	std::cout << "transfers: " << flights.stats.started << ", joined: " << flights.stats.joined << "\n";
+}
@@ -0,0 +1,66 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/snapshot.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+auto fetch(std::string url) -> co_curl::promise<size_t> {
+	auto handle = co_curl::easy_handle{url};
+
+	std::string output;
+	handle.write_into(output);
+
+	if (!co_await handle.perform()) {
+		co_return 0u;
+	}
+
+	co_return output.size();
+}
+
+auto fetch_all(std::vector<std::string> urls) -> co_curl::promise<size_t> {
+	co_await co_curl::label("fetch_all");
+
+	std::vector<co_curl::promise<size_t>> transfers{};
+
+	for (const std::string & url: urls) {
+		transfers.push_back(fetch(url));
+	}
+
+	size_t total = 0;
+
+	for (auto & t: transfers) {
+		total += co_await t;
+	}
+
+	co_return total;
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: snapshot URL...\n";
+		return 1;
+	}
+
+	// running transfers and awaits between coroutines are tracked only for snapshots
+	co_curl::get_scheduler().get_introspection().enabled = true;
+
+	std::atomic<bool> done{false};
+
+	// what a debug endpoint served from another thread would do
+	auto watcher = std::thread{[&] {
+		std::this_thread::sleep_for(std::chrono::milliseconds{500});
+
+		while (!done.load()) {
+			if (const auto snapshot = co_curl::request_snapshot(std::chrono::milliseconds{200})) {
+				std::cout << snapshot->to_json() << "\n";
+				return;
+			}
+		}
+	}};
+
+	const size_t total = fetch_all(std::vector<std::string>(argv + 1, argv + argc));
+	done = true;
+	watcher.join();
+
+	std::cout << "downloaded " << total << " bytes\n";
+}
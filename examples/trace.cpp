@@ -0,0 +1,48 @@
+#include <co_curl/co_curl.hpp>
+#include <co_curl/trace.hpp>
+#include <fstream>
+
+auto fetch(std::string url) -> co_curl::promise<size_t> {
+	auto handle = co_curl::easy_handle{url};
+
+	std::string output;
+	handle.write_into(output);
+
+	if (!co_await handle.perform()) {
+		co_return 0u;
+	}
+
+	co_return output.size();
+}
+
+auto fetch_two(std::string a, std::string b) -> co_curl::promise<size_t> {
+	auto x = fetch(a);
+	auto y = fetch(b);
+
+	co_return co_await x + co_await y;
+}
+
+auto fan_out(std::string url) -> co_curl::promise<size_t> {
+	auto a = fetch_two(url, url);
+	auto b = fetch_two(url, url);
+
+	co_return co_await a + co_await b;
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 3) {
+		std::cerr << "usage: trace URL OUTPUT.json\n";
+		return 1;
+	}
+
+	if constexpr (!co_curl::tracing_enabled) {
+		std::cerr << "co_curl was built without CO_CURL_TRACING, the trace will be empty\n";
+	}
+
+	const size_t total = fan_out(argv[1]);
+	std::cout << "downloaded " << total << " bytes\n";
+
+	// open it in chrome://tracing or https://ui.perfetto.dev
+	auto out = std::ofstream{argv[2]};
+	co_curl::write_chrome_trace(out);
+}
@@ -0,0 +1,30 @@
+#include <co_curl/co_curl.hpp>
+
+auto fetch_twice(std::string url) -> co_curl::promise<bool> {
+	auto handle = co_curl::easy_handle{url};
+
+	std::string output;
+	handle.write_into(output);
+
+	for (int i = 0; i != 2; ++i) {
+		output.clear();
+
+		if (!co_await handle.perform()) {
+			co_return false;
+		}
+
+		// second transfer reuses the connection
+		std::cout << url << ": " << handle.get_transfer_stats() << "\n";
+	}
+
+	co_return true;
+}
+
+int main(int argc, char ** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: transfer-stats URL\n";
+		return 1;
+	}
+
+	return fetch_twice(argv[1]) ? 0 : 1;
+}
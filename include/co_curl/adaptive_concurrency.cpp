@@ -0,0 +1,151 @@
+#include "adaptive_concurrency.hpp"
+#include <algorithm>
+
+auto co_curl::adaptive_concurrency::get(std::string_view host) -> host_limit & {
+	if (const auto it = hosts.find(host); it != hosts.end()) {
+		return it->second;
+	}
+
+	return hosts.emplace(std::string(host), host_limit{.limit = static_cast<double>(options.initial_limit)}).first->second;
+}
+
+static auto whole_limit(const co_curl::host_limit & h) noexcept -> unsigned {
+	return std::max(static_cast<unsigned>(h.limit), 1u);
+}
+
+void co_curl::adaptive_concurrency::forget_if_idle(std::string_view host) noexcept {
+	const auto it = hosts.find(host);
+
+	if (it == hosts.end()) {
+		return;
+	}
+
+	const host_limit & h = it->second;
+
+	// such host would be created again the same (only the latency baseline is lost)
+	if (h.in_flight == 0u && h.queue.empty() && whole_limit(h) == options.initial_limit) {
+		hosts.erase(it);
+	}
+}
+
+bool co_curl::adaptive_concurrency::try_start(std::string_view host, queued_transfer transfer) {
+	host_limit & h = get(host);
+
+	// FIFO, newcomers don't overtake already waiting transfers
+	if (h.queue.empty() && h.in_flight < whole_limit(h)) {
+		++h.in_flight;
+		return true;
+	}
+
+	h.queue.push_back(transfer);
+	++stats.queued;
+	return false;
+}
+
+void co_curl::adaptive_concurrency::finished(std::string_view host, outcome result, std::optional<std::chrono::microseconds> latency, clock::time_point now) {
+	host_limit & h = get(host);
+
+	const bool was_saturated = h.in_flight >= whole_limit(h);
+
+	if (h.in_flight != 0u) {
+		--h.in_flight;
+	}
+
+	bool congested = (result == outcome::overload);
+
+	if (result == outcome::success && latency) {
+		const double sample = static_cast<double>(latency->count()) / 1000.0;
+
+		if (const auto baseline = h.baseline_ms()) {
+			congested = sample > *baseline * options.latency_tolerance;
+		}
+
+		// windowed minimum (the previous window is kept so the baseline doesn't jump at its start)
+		if (now - h.window_start >= options.baseline_window) {
+			// after a quiet period both windows are too old
+			const bool adjacent = now - h.window_start < 2 * options.baseline_window;
+			h.previous_min_ms = adjacent ? h.window_min_ms : std::nullopt;
+			h.window_min_ms = std::nullopt;
+			h.window_start = now;
+		}
+
+		h.window_min_ms = std::min(h.window_min_ms.value_or(sample), sample);
+	}
+
+	if (congested) {
+		if (now - h.last_decrease >= options.decrease_interval) {
+			h.limit = std::max(h.limit * options.decrease_factor, static_cast<double>(options.min_limit));
+			h.last_decrease = now;
+			++stats.decreases;
+		}
+	} else if (result == outcome::success && was_saturated) {
+		// growing is useful only when the limit was actually reached
+		const auto before = whole_limit(h);
+		h.limit = std::min(h.limit + options.increase / h.limit, static_cast<double>(options.max_limit));
+
+		if (whole_limit(h) != before) {
+			++stats.increases;
+		}
+	}
+
+	forget_if_idle(host);
+}
+
+auto co_curl::adaptive_concurrency::next_to_start(std::string_view host) -> std::optional<queued_transfer> {
+	const auto it = hosts.find(host);
+
+	if (it == hosts.end()) {
+		return std::nullopt;
+	}
+
+	host_limit & h = it->second;
+
+	if (h.queue.empty() || h.in_flight >= whole_limit(h)) {
+		return std::nullopt;
+	}
+
+	const auto next = h.queue.front();
+	h.queue.pop_front();
+	++h.in_flight;
+	return next;
+}
+
+void co_curl::adaptive_concurrency::cancel(std::string_view host, const easy_handle & handle, bool started) noexcept {
+	const auto it = hosts.find(host);
+
+	if (it == hosts.end()) {
+		return;
+	}
+
+	host_limit & h = it->second;
+
+	if (started) {
+		if (h.in_flight != 0u) {
+			--h.in_flight;
+		}
+	} else {
+		std::erase_if(h.queue, [&](const queued_transfer & q) { return q.handle == &handle; });
+	}
+
+	forget_if_idle(host);
+}
+
+auto co_curl::adaptive_concurrency::limit_of(std::string_view host) const noexcept -> unsigned {
+	if (const auto it = hosts.find(host); it != hosts.end()) {
+		return whole_limit(it->second);
+	}
+
+	return options.initial_limit;
+}
+
+auto co_curl::adaptive_concurrency::classify(result r, unsigned http_code) noexcept -> outcome {
+	if (r.is_timeout() || http_code == 429u || http_code == 503u) {
+		return outcome::overload;
+	}
+
+	if (!r || http_code >= 500u) {
+		return outcome::other_failure;
+	}
+
+	return outcome::success;
+}
@@ -0,0 +1,117 @@
+#ifndef CO_CURL_ADAPTIVE_CONCURRENCY_HPP
+#define CO_CURL_ADAPTIVE_CONCURRENCY_HPP
+
+#include "easy.hpp"
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+
+namespace co_curl {
+
+struct adaptive_concurrency_options {
+	unsigned initial_limit{4};
+	unsigned min_limit{1};
+	unsigned max_limit{64};
+
+	// additive increase: limit grows by `increase` after `limit` successful transfers (roughly once per round trip)
+	double increase{1.0};
+
+	// multiplicative decrease on a timeout, 429/503 or a latency spike
+	double decrease_factor{0.7};
+
+	// time to first byte above `baseline * latency_tolerance` is a spike
+	double latency_tolerance{2.0};
+
+	// baseline is the lowest latency seen in the last one or two of these windows, so an exceptionally fast
+	// response (or a route which got slower) stops being the reference once its window passes
+	std::chrono::milliseconds baseline_window{std::chrono::seconds{10}};
+
+	// one congestion event shouldn't cut the limit for every transfer which was in flight
+	std::chrono::milliseconds decrease_interval{100};
+};
+
+// transfer waiting for a free slot of its host
+struct queued_transfer {
+	std::coroutine_handle<> coroutine{};
+	easy_handle * handle{nullptr};
+};
+
+struct host_limit {
+	using clock = std::chrono::steady_clock;
+
+	double limit{0.0};
+	unsigned in_flight{0};
+	std::optional<double> window_min_ms{};
+	std::optional<double> previous_min_ms{};
+	clock::time_point window_start{};
+	clock::time_point last_decrease{};
+	std::deque<queued_transfer> queue{};
+
+	auto baseline_ms() const noexcept -> std::optional<double> {
+		if (window_min_ms && previous_min_ms) {
+			return std::min(*window_min_ms, *previous_min_ms);
+		}
+
+		return window_min_ms ? window_min_ms : previous_min_ms;
+	}
+};
+
+struct adaptive_concurrency_stats {
+	size_t queued{0};
+	size_t increases{0};
+	size_t decreases{0};
+};
+
+// AIMD limit of transfers in flight for each host, consulted by the scheduler only when enabled
+struct adaptive_concurrency {
+	using clock = host_limit::clock;
+
+	enum class outcome { success, overload, other_failure };
+
+	bool enabled{false};
+	adaptive_concurrency_options options{};
+
+	struct host_hash {
+		using is_transparent = void;
+
+		size_t operator()(std::string_view host) const noexcept {
+			return std::hash<std::string_view>{}(host);
+		}
+	};
+
+	std::unordered_map<std::string, host_limit, host_hash, std::equal_to<>> hosts{};
+	adaptive_concurrency_stats stats{};
+
+	auto get(std::string_view host) -> host_limit &;
+
+	// true when the transfer can start now, otherwise it's queued
+	bool try_start(std::string_view host, queued_transfer transfer);
+
+	// finished transfer of the host (latency is time to first byte when known)
+	void finished(std::string_view host, outcome result, std::optional<std::chrono::microseconds> latency, clock::time_point now = clock::now());
+
+	// next queued transfer which can start now (it's counted as in flight already)
+	auto next_to_start(std::string_view host) -> std::optional<queued_transfer>;
+
+	// transfer was cancelled (while in flight or while queued)
+	void cancel(std::string_view host, const easy_handle & handle, bool started) noexcept;
+
+	auto limit_of(std::string_view host) const noexcept -> unsigned;
+
+	static auto classify(result r, unsigned http_code) noexcept -> outcome;
+
+	// internals
+	// hosts without transfers and with the initial limit are removed, so the map doesn't grow with every host ever seen
+	void forget_if_idle(std::string_view host) noexcept;
+};
+
+} // namespace co_curl
+
+#endif
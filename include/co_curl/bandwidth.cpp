@@ -0,0 +1,244 @@
+#include "bandwidth.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <curl/curl.h>
+
+namespace {
+
+using claim = co_curl::bandwidth_manager::claim;
+
+constexpr double unlimited_demand = std::numeric_limits<double>::infinity();
+
+// max-min fair split of the budget by weights, nobody gets more than its demand unless everyone is satisfied
+void water_fill(double budget, std::vector<claim> & claims, std::vector<claim *> & unsatisfied) {
+	unsatisfied.clear();
+
+	for (claim & c: claims) {
+		c.share = 0.0;
+		unsatisfied.push_back(&c);
+	}
+
+	while (!unsatisfied.empty() && budget > 0.0) {
+		double total_weight = 0.0;
+
+		for (const claim * c: unsatisfied) {
+			total_weight += c->weight;
+		}
+
+		const auto satisfied = std::partition(unsatisfied.begin(), unsatisfied.end(), [&](const claim * c) { return c->demand > budget * c->weight / total_weight; });
+
+		if (satisfied == unsatisfied.end()) {
+			for (claim * c: unsatisfied) {
+				c->share = budget * c->weight / total_weight;
+			}
+			return;
+		}
+
+		for (auto it = satisfied; it != unsatisfied.end(); ++it) {
+			(*it)->share = (*it)->demand;
+			budget -= (*it)->demand;
+		}
+
+		unsatisfied.erase(satisfied, unsatisfied.end());
+	}
+
+	// everyone is satisfied: leftover is split too so transfers can grow until the next rebalance
+	if (unsatisfied.empty() && budget > 0.0) {
+		double total_weight = 0.0;
+
+		for (const claim & c: claims) {
+			total_weight += c.weight;
+		}
+
+		for (claim & c: claims) {
+			c.share += budget * c.weight / total_weight;
+		}
+	}
+}
+
+auto demand_of(const co_curl::bandwidth_manager::direction & d, size_t minimal_rate) noexcept -> double {
+	// unknown demand, or transfer which uses (almost) whole cap, can use more
+	if (d.cap == 0.0 || d.rate == 0.0 || d.rate >= d.cap * 0.8) {
+		return unlimited_demand;
+	}
+
+	return d.rate * 1.25 + static_cast<double>(minimal_rate);
+}
+
+void apply_cap(CURL * handle, size_t dir, double cap) noexcept {
+	const auto value = static_cast<curl_off_t>(cap);
+	curl_easy_setopt(handle, dir == 0u ? CURLOPT_MAX_RECV_SPEED_LARGE : CURLOPT_MAX_SEND_SPEED_LARGE, value);
+}
+
+} // namespace
+
+void co_curl::bandwidth_manager::set_group(std::string name, bandwidth_limits limits, double weight) {
+	groups.insert_or_assign(std::move(name), bandwidth_group{.limits = limits, .weight = std::max(weight, 0.001)});
+}
+
+void co_curl::bandwidth_manager::assign(easy_handle & handle, std::string group, double weight) {
+	transfer & t = transfers[handle.native_handle];
+	t.group = std::move(group);
+	t.weight = std::max(weight, 0.001);
+
+	// running transfer moves into the group right away
+	if (t.active) {
+		rebalance();
+	}
+}
+
+void co_curl::bandwidth_manager::started(CURL * handle) {
+	// group and weight assigned before the transfer are kept
+	transfer & t = transfers[handle];
+	t.active = true;
+	t.directions = {};
+	rebalance();
+}
+
+void co_curl::bandwidth_manager::finished(CURL * handle) noexcept {
+	const auto it = transfers.find(handle);
+
+	if (it == transfers.end()) {
+		return;
+	}
+
+	// handle can be reused for a transfer which is not shaped
+	for (size_t dir = 0; dir != it->second.directions.size(); ++dir) {
+		if (it->second.directions[dir].cap != 0.0) {
+			apply_cap(handle, dir, 0.0);
+		}
+	}
+
+	transfers.erase(it);
+
+	try {
+		rebalance();
+	} catch (...) {
+		// caps stay as they are until the next tick
+	}
+}
+
+void co_curl::bandwidth_manager::tick(clock::time_point now) {
+	const auto elapsed = now - last_tick;
+
+	if (elapsed < interval) {
+		return;
+	}
+
+	last_tick = now;
+
+	const double seconds = std::chrono::duration<double>(elapsed).count();
+
+	// curl keeps the average rate under the cap but reads in bursts, so rates are smoothed over about a second
+	const double alpha = 1.0 - std::exp(-seconds);
+
+	for (auto & [handle, t]: transfers) {
+		if (!t.active) {
+			continue;
+		}
+
+		curl_off_t bytes[2]{0, 0};
+		curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &bytes[0]);
+		curl_easy_getinfo(handle, CURLINFO_SIZE_UPLOAD_T, &bytes[1]);
+
+		for (size_t dir = 0; dir != t.directions.size(); ++dir) {
+			direction & d = t.directions[dir];
+			const double sample = static_cast<double>(std::max<std::int64_t>(bytes[dir] - d.bytes, 0)) / seconds;
+			d.rate = (d.rate == 0.0) ? sample : d.rate + alpha * (sample - d.rate);
+			d.bytes = bytes[dir];
+		}
+	}
+
+	rebalance();
+}
+
+void co_curl::bandwidth_manager::rebalance() {
+	// active transfers grouped by their group
+	members.clear();
+	member_groups.clear();
+
+	for (auto & [handle, t]: transfers) {
+		if (t.active) {
+			members.push_back(member{.group = t.group, .handle = handle, .t = &t});
+		}
+	}
+
+	std::ranges::sort(members, {}, &member::group);
+
+	for (size_t begin = 0; begin != members.size();) {
+		size_t end = begin + 1u;
+
+		while (end != members.size() && members[end].group == members[begin].group) {
+			++end;
+		}
+
+		member_groups.emplace_back(begin, end);
+		begin = end;
+	}
+
+	for (size_t dir = 0; dir != 2u; ++dir) {
+		const size_t global_limit = (dir == 0u) ? global.recv : global.send;
+
+		group_claims.clear();
+		group_limits.clear();
+
+		for (const auto & [begin, end]: member_groups) {
+			const auto g = groups.find(members[begin].group);
+			const size_t limit = (g == groups.end()) ? 0u : ((dir == 0u) ? g->second.limits.recv : g->second.limits.send);
+
+			double demand = 0.0;
+
+			for (size_t i = begin; i != end; ++i) {
+				demand += demand_of(members[i].t->directions[dir], minimal_rate);
+			}
+
+			if (limit != 0u) {
+				demand = std::min(demand, static_cast<double>(limit));
+			}
+
+			group_claims.push_back(claim{.weight = (g == groups.end()) ? 1.0 : g->second.weight, .demand = demand});
+			group_limits.push_back(static_cast<double>(limit));
+		}
+
+		if (global_limit != 0u) {
+			water_fill(static_cast<double>(global_limit), group_claims, unsatisfied);
+		}
+
+		for (size_t index = 0; index != member_groups.size(); ++index) {
+			const auto [begin, end] = member_groups[index];
+
+			double budget = group_limits[index];
+			bool limited = (budget != 0.0);
+
+			if (global_limit != 0u) {
+				budget = limited ? std::min(budget, group_claims[index].share) : group_claims[index].share;
+				limited = true;
+			}
+
+			transfer_claims.clear();
+
+			for (size_t i = begin; i != end; ++i) {
+				transfer_claims.push_back(claim{.weight = members[i].t->weight, .demand = demand_of(members[i].t->directions[dir], minimal_rate)});
+			}
+
+			if (limited) {
+				water_fill(budget, transfer_claims, unsatisfied);
+			}
+
+			for (size_t i = begin; i != end; ++i) {
+				direction & d = members[i].t->directions[dir];
+
+				const double cap = !limited ? 0.0 : std::max(transfer_claims[i - begin].share, static_cast<double>(minimal_rate));
+
+				// avoid touching curl for changes which wouldn't matter
+				if (cap == d.cap || (cap != 0.0 && d.cap != 0.0 && std::abs(cap - d.cap) < d.cap * 0.02)) {
+					continue;
+				}
+
+				d.cap = cap;
+				apply_cap(members[i].handle, dir, cap);
+			}
+		}
+	}
+}
@@ -0,0 +1,109 @@
+#ifndef CO_CURL_BANDWIDTH_HPP
+#define CO_CURL_BANDWIDTH_HPP
+
+#include "easy.hpp"
+#include <array>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace co_curl {
+
+// bytes per second, zero means unlimited
+struct bandwidth_limits {
+	size_t recv{0};
+	size_t send{0};
+};
+
+struct bandwidth_group {
+	bandwidth_limits limits{};
+
+	// share of the global budget compared to other groups with active transfers
+	double weight{1.0};
+};
+
+// divides global and per-group budgets among running transfers by their weights and applies the result as
+// CURLOPT_MAX_RECV_SPEED_LARGE/CURLOPT_MAX_SEND_SPEED_LARGE, transfers which don't use their share leave it to others
+// (max-min fairness with demands estimated from the observed rates), consulted by the scheduler only when enabled
+struct bandwidth_manager {
+	using clock = std::chrono::steady_clock;
+
+	bool enabled{false};
+	bandwidth_limits global{};
+
+	// how often are rates measured and shares recomputed
+	std::chrono::milliseconds interval{100};
+
+	// no transfer is slowed down below this (so low speed timeouts don't fire)
+	size_t minimal_rate{4096};
+
+	struct group_hash {
+		using is_transparent = void;
+
+		size_t operator()(std::string_view name) const noexcept {
+			return std::hash<std::string_view>{}(name);
+		}
+	};
+
+	std::unordered_map<std::string, bandwidth_group, group_hash, std::equal_to<>> groups{};
+
+	struct direction {
+		std::int64_t bytes{0};
+		double rate{0.0};
+		double cap{0.0}; // zero means unlimited
+	};
+
+	struct transfer {
+		std::string group{};
+		double weight{1.0};
+		bool active{false};
+		std::array<direction, 2> directions{}; // recv, send
+	};
+
+	std::unordered_map<CURL *, transfer> transfers{};
+	clock::time_point last_tick{};
+
+	void set_group(std::string name, bandwidth_limits limits, double weight = 1.0);
+
+	// put the running or the next transfer of the handle into the group (transfers without it are in group "")
+	// assignment is forgotten when the transfer finishes or is cancelled (a transfer rejected by a circuit breaker keeps it)
+	void assign(easy_handle & handle, std::string group, double weight = 1.0);
+
+	// used by the scheduler
+	void started(CURL * handle);
+	void finished(CURL * handle) noexcept;
+	void tick(clock::time_point now = clock::now());
+	void rebalance();
+
+	// internals
+	struct claim {
+		double weight{1.0};
+		double demand{std::numeric_limits<double>::infinity()};
+		double share{0.0};
+	};
+
+	struct member {
+		std::string_view group{};
+		CURL * handle{nullptr};
+		transfer * t{nullptr};
+	};
+
+	// scratch storage of rebalance() (kept so it doesn't allocate every time)
+	std::vector<member> members{};
+	std::vector<std::pair<size_t, size_t>> member_groups{}; // ranges of members with the same group
+	std::vector<claim> group_claims{};
+	std::vector<double> group_limits{};
+	std::vector<claim> transfer_claims{};
+	std::vector<claim *> unsatisfied{};
+};
+
+} // namespace co_curl
+
+#endif
@@ -0,0 +1,51 @@
+#include "buffer_chain.hpp"
+#include <limits.h>
+#include <sys/uio.h>
+#include <cerrno>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+bool co_curl::buffer_chain::write_to(int fd) const {
+	std::vector<iovec> vectors{};
+	vectors.reserve(std::min(segments.size(), size_t(IOV_MAX)));
+
+	auto it = segments.begin();
+	size_t already_written_in_first = 0;
+
+	while (it != segments.end()) {
+		vectors.clear();
+
+		for (auto jt = it; jt != segments.end() && vectors.size() < size_t(IOV_MAX); ++jt) {
+			const auto content = (*jt)->content().subspan(jt == it ? already_written_in_first : 0u);
+			vectors.push_back(iovec{.iov_base = const_cast<char *>(content.data()), .iov_len = content.size()});
+		}
+
+		const auto r = ::writev(fd, vectors.data(), static_cast<int>(vectors.size()));
+
+		if (r < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return false;
+		}
+
+		// skip fully written segments and remember position in partially written one
+		auto written = static_cast<size_t>(r);
+
+		for (const iovec & v: vectors) {
+			if (written < v.iov_len) {
+				already_written_in_first += written;
+				break;
+			}
+
+			written -= v.iov_len;
+			already_written_in_first = 0;
+			++it;
+		}
+	}
+
+	return true;
+}
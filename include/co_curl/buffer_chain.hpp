@@ -0,0 +1,162 @@
+#ifndef CO_CURL_BUFFER_CHAIN_HPP
+#define CO_CURL_BUFFER_CHAIN_HPP
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+namespace co_curl {
+
+struct buffer_segment {
+	static constexpr size_t capacity = 16u * 1024u;
+
+	size_t used{0};
+	std::array<char, capacity> data; // intentionally not value-initialized
+
+	constexpr auto free_space() noexcept -> std::span<char> {
+		return std::span<char>(data).subspan(used);
+	}
+
+	constexpr auto content() const noexcept -> std::span<const char> {
+		return std::span<const char>(data).first(used);
+	}
+};
+
+// segments are recycled per thread, the scheduler is single-threaded anyway
+struct segment_pool {
+	std::vector<std::unique_ptr<buffer_segment>> available{};
+	size_t max_retained{256}; // 4 MiB
+
+	auto take() -> std::unique_ptr<buffer_segment> {
+		if (available.empty()) {
+			return std::make_unique_for_overwrite<buffer_segment>();
+		}
+
+		auto out = std::move(available.back());
+		available.pop_back();
+		return out;
+	}
+
+	void give_back(std::unique_ptr<buffer_segment> segment) noexcept {
+		if (available.size() >= max_retained) {
+			return;
+		}
+
+		segment->used = 0;
+
+		try {
+			available.emplace_back(std::move(segment));
+		} catch (...) {
+			// if we can't remember it, just free it
+		}
+	}
+};
+
+inline auto get_segment_pool() -> segment_pool & {
+	thread_local segment_pool pool{};
+	return pool;
+}
+
+// response body stored in fixed size segments, it never reallocates or copies already received data
+struct buffer_chain {
+	using value_type = char;
+
+	std::vector<std::unique_ptr<buffer_segment>> segments{};
+	size_t total_size{0};
+
+	buffer_chain() noexcept = default;
+	buffer_chain(const buffer_chain &) = delete;
+	buffer_chain(buffer_chain && other) noexcept: segments{std::move(other.segments)}, total_size{std::exchange(other.total_size, 0u)} { }
+
+	buffer_chain & operator=(const buffer_chain &) = delete;
+	buffer_chain & operator=(buffer_chain && other) noexcept {
+		std::swap(segments, other.segments);
+		std::swap(total_size, other.total_size);
+		return *this;
+	}
+
+	~buffer_chain() noexcept {
+		clear();
+	}
+
+	// used by easy_handle::write_into
+	void append(const char * ptr, size_t length) {
+		while (length != 0u) {
+			if (segments.empty() || segments.back()->used == buffer_segment::capacity) {
+				segments.emplace_back(get_segment_pool().take());
+			}
+
+			buffer_segment & last = *segments.back();
+			const auto target = last.free_space();
+			const auto common_length = std::min(target.size(), length);
+
+			std::copy_n(ptr, common_length, target.begin());
+
+			last.used += common_length;
+			total_size += common_length;
+			ptr += common_length;
+			length -= common_length;
+		}
+	}
+
+	void append(std::span<const char> in) {
+		append(in.data(), in.size());
+	}
+
+	void push_back(char c) {
+		append(&c, 1u);
+	}
+
+	void clear() noexcept {
+		auto & pool = get_segment_pool();
+
+		for (auto & segment: segments) {
+			pool.give_back(std::move(segment));
+		}
+
+		segments.clear();
+		total_size = 0;
+	}
+
+	constexpr size_t size() const noexcept {
+		return total_size;
+	}
+
+	constexpr bool empty() const noexcept {
+		return total_size == 0u;
+	}
+
+	// iterate over content as `std::span<const char>`
+	auto chunks() const noexcept {
+		return segments | std::views::transform([](const std::unique_ptr<buffer_segment> & segment) { return segment->content(); });
+	}
+
+	// scatter-gather write of whole content into a file descriptor (handles partial writes)
+	bool write_to(int fd) const;
+
+	// copy into one contiguous container only when really needed
+	template <typename Container = std::string> auto flatten() const -> Container {
+		Container output;
+		output.reserve(total_size);
+
+		for (std::span<const char> chunk: chunks()) {
+			output.insert(output.end(), chunk.begin(), chunk.end());
+		}
+
+		return output;
+	}
+
+	explicit operator std::string() const {
+		return flatten<std::string>();
+	}
+};
+
+} // namespace co_curl
+
+#endif
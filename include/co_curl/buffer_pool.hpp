@@ -0,0 +1,199 @@
+#ifndef CO_CURL_BUFFER_POOL_HPP
+#define CO_CURL_BUFFER_POOL_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+namespace co_curl {
+
+struct buffer_pool;
+
+// body buffer leased from a pool, its storage goes back to the pool when released
+struct pooled_buffer {
+	using value_type = char;
+
+	std::string storage{};
+	buffer_pool * pool{nullptr};
+
+	constexpr pooled_buffer() noexcept = default;
+	pooled_buffer(std::string && s, buffer_pool & p) noexcept: storage{std::move(s)}, pool{&p} { }
+	pooled_buffer(const pooled_buffer &) = delete;
+	pooled_buffer(pooled_buffer && other) noexcept: storage{std::move(other.storage)}, pool{std::exchange(other.pool, nullptr)} { }
+
+	pooled_buffer & operator=(const pooled_buffer &) = delete;
+	pooled_buffer & operator=(pooled_buffer && other) noexcept {
+		std::swap(storage, other.storage);
+		std::swap(pool, other.pool);
+		return *this;
+	}
+
+	~pooled_buffer() noexcept {
+		release();
+	}
+
+	// return storage to the pool early
+	void release() noexcept;
+
+	// take the storage out of the pool's accounting
+	auto extract() && noexcept -> std::string {
+		pool = nullptr;
+		return std::move(storage);
+	}
+
+	// used by easy_handle::write_into
+	void append(const char * ptr, size_t length) {
+		storage.append(ptr, length);
+	}
+
+	void push_back(char c) {
+		storage.push_back(c);
+	}
+
+	void clear() noexcept {
+		storage.clear();
+	}
+
+	void reserve(size_t n) {
+		storage.reserve(n);
+	}
+
+	size_t size() const noexcept {
+		return storage.size();
+	}
+
+	bool empty() const noexcept {
+		return storage.empty();
+	}
+
+	const char * data() const noexcept {
+		return storage.data();
+	}
+
+	auto view() const noexcept -> std::string_view {
+		return storage;
+	}
+
+	operator std::string_view() const noexcept {
+		return storage;
+	}
+
+	friend auto operator<<(std::ostream & os, const pooled_buffer & buffer) -> std::ostream & {
+		return os << buffer.view();
+	}
+};
+
+struct buffer_pool_stats {
+	size_t hits{0};
+	size_t misses{0};
+	size_t returned{0};
+	size_t dropped{0};
+	size_t retained_bytes{0};
+
+	constexpr double hit_rate() const noexcept {
+		const auto total = hits + misses;
+		return total == 0u ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+	}
+};
+
+// buffers are kept in power-of-two size classes (4 KiB .. 16 MiB), not thread-safe same as the scheduler which owns it
+struct buffer_pool {
+	static constexpr size_t smallest_class = 4u * 1024u;
+	static constexpr size_t number_of_classes = 13u;
+	static constexpr size_t largest_class = smallest_class << (number_of_classes - 1u);
+
+	std::array<std::vector<std::string>, number_of_classes> available{};
+	size_t max_retained_bytes{64u * 1024u * 1024u};
+	buffer_pool_stats stats{};
+
+	buffer_pool() noexcept = default;
+	buffer_pool(const buffer_pool &) = delete;
+	buffer_pool & operator=(const buffer_pool &) = delete;
+
+	static constexpr size_t class_size(size_t index) noexcept {
+		return smallest_class << index;
+	}
+
+	// smallest class which can hold `size` bytes
+	static constexpr size_t class_for_request(size_t size) noexcept {
+		if (size <= smallest_class) {
+			return 0u;
+		}
+
+		return std::min(static_cast<size_t>(std::bit_width((size - 1u) / smallest_class)), number_of_classes - 1u);
+	}
+
+	// largest class fully covered by a buffer with `capacity`
+	static constexpr size_t class_for_capacity(size_t capacity) noexcept {
+		return static_cast<size_t>(std::bit_width(capacity / smallest_class)) - 1u;
+	}
+
+	auto lease(size_t size_hint = 0u) -> pooled_buffer {
+		for (size_t index = class_for_request(size_hint); index != number_of_classes; ++index) {
+			auto & bucket = available[index];
+
+			if (!bucket.empty()) {
+				auto out = std::move(bucket.back());
+				bucket.pop_back();
+
+				stats.retained_bytes -= out.capacity();
+				++stats.hits;
+
+				return pooled_buffer{std::move(out), *this};
+			}
+		}
+
+		++stats.misses;
+
+		std::string out{};
+		out.reserve(class_size(class_for_request(size_hint)));
+		return pooled_buffer{std::move(out), *this};
+	}
+
+	void give_back(std::string && buffer) noexcept {
+		const auto capacity = buffer.capacity();
+
+		if (capacity < smallest_class || capacity > 2u * largest_class || stats.retained_bytes + capacity > max_retained_bytes) {
+			++stats.dropped;
+			return;
+		}
+
+		buffer.clear();
+
+		try {
+			available[class_for_capacity(std::min(capacity, largest_class))].emplace_back(std::move(buffer));
+		} catch (...) {
+			++stats.dropped;
+			return;
+		}
+
+		stats.retained_bytes += capacity;
+		++stats.returned;
+	}
+
+	// free everything retained
+	void trim() noexcept {
+		for (auto & bucket: available) {
+			bucket.clear();
+			bucket.shrink_to_fit();
+		}
+
+		stats.retained_bytes = 0u;
+	}
+};
+
+inline void pooled_buffer::release() noexcept {
+	if (auto * p = std::exchange(pool, nullptr)) {
+		p->give_back(std::move(storage));
+	}
+}
+
+} // namespace co_curl
+
+#endif
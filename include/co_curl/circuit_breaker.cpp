@@ -0,0 +1,107 @@
+#include "circuit_breaker.hpp"
+
+static void open_circuit(co_curl::host_circuit & circuit, co_curl::circuit_breaker_stats & stats, co_curl::host_circuit::clock::time_point now) noexcept {
+	circuit.state = co_curl::circuit_state::open;
+	circuit.opened_at = now;
+	circuit.probes_in_flight = 0;
+	circuit.probe_successes = 0;
+	++stats.opened;
+}
+
+auto co_curl::circuit_breakers::admit(std::string_view host, clock::time_point now) -> circuit_admission {
+	auto it = hosts.find(host);
+
+	if (it == hosts.end()) {
+		// healthy hosts are not tracked until they fail
+		return circuit_admission{};
+	}
+
+	host_circuit & circuit = it->second;
+
+	if (circuit.state == circuit_state::open && now - circuit.opened_at >= options.open_duration) {
+		circuit.state = circuit_state::half_open;
+		circuit.half_open_period = ++half_open_periods;
+	}
+
+	switch (circuit.state) {
+	case circuit_state::closed:
+		return circuit_admission{};
+	case circuit_state::half_open:
+		if (circuit.probes_in_flight < options.probes) {
+			++circuit.probes_in_flight;
+			return circuit_admission{.allowed = true, .probe = circuit.half_open_period};
+		}
+		break;
+	case circuit_state::open:
+		break;
+	}
+
+	++stats.rejected;
+	return circuit_admission{.allowed = false};
+}
+
+void co_curl::circuit_breakers::record(std::string_view host, std::uint64_t probe, bool failed, clock::time_point now) {
+	auto it = hosts.find(host);
+
+	if (it == hosts.end()) {
+		if (!failed) {
+			return;
+		}
+
+		it = hosts.emplace(std::string(host), host_circuit{}).first;
+	}
+
+	host_circuit & circuit = it->second;
+
+	switch (circuit.state) {
+	case circuit_state::closed:
+		if (!failed) {
+			// forget healthy hosts
+			hosts.erase(it);
+		} else if (++circuit.consecutive_failures >= options.failure_threshold) {
+			open_circuit(circuit, stats, now);
+		}
+		break;
+	case circuit_state::half_open:
+		// transfers started before the circuit opened and probes of an earlier half-open period don't count
+		// (their period ended by opening the circuit, which reset the counters)
+		if (probe != circuit.half_open_period) {
+			break;
+		}
+
+		--circuit.probes_in_flight;
+
+		if (failed) {
+			open_circuit(circuit, stats, now);
+		} else if (++circuit.probe_successes >= options.successes_to_close) {
+			++stats.closed;
+			hosts.erase(it);
+		}
+		break;
+	case circuit_state::open:
+		// late results of transfers started before opening
+		break;
+	}
+}
+
+void co_curl::circuit_breakers::abandon(std::string_view host, std::uint64_t probe) noexcept {
+	if (probe == 0u) {
+		return;
+	}
+
+	if (const auto it = hosts.find(host); it != hosts.end() && it->second.state == circuit_state::half_open && it->second.half_open_period == probe && it->second.probes_in_flight != 0u) {
+		--it->second.probes_in_flight;
+	}
+}
+
+auto co_curl::circuit_breakers::state_of(std::string_view host, clock::time_point now) const noexcept -> circuit_state {
+	if (const auto it = hosts.find(host); it != hosts.end()) {
+		if (it->second.state == circuit_state::open && now - it->second.opened_at >= options.open_duration) {
+			return circuit_state::half_open;
+		}
+
+		return it->second.state;
+	}
+
+	return circuit_state::closed;
+}
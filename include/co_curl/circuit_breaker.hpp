@@ -0,0 +1,92 @@
+#ifndef CO_CURL_CIRCUIT_BREAKER_HPP
+#define CO_CURL_CIRCUIT_BREAKER_HPP
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace co_curl {
+
+struct circuit_breaker_options {
+	// consecutive failures which open the circuit
+	unsigned failure_threshold{5};
+
+	// how long are transfers rejected before probing
+	std::chrono::milliseconds open_duration{std::chrono::seconds{5}};
+
+	// transfers allowed at once in half-open state, and how many of them must succeed to close the circuit
+	unsigned probes{1};
+	unsigned successes_to_close{1};
+
+	// count 5XX responses as failures too (otherwise only connection errors and timeouts are)
+	bool count_server_errors{false};
+};
+
+enum class circuit_state { closed, open, half_open };
+
+struct host_circuit {
+	using clock = std::chrono::steady_clock;
+
+	circuit_state state{circuit_state::closed};
+	unsigned consecutive_failures{0};
+	unsigned probes_in_flight{0};
+	unsigned probe_successes{0};
+	std::uint64_t half_open_period{0}; // probes of earlier periods are ignored
+	clock::time_point opened_at{};
+};
+
+struct circuit_admission {
+	bool allowed{true};
+	std::uint64_t probe{0}; // half-open period the transfer probes (zero when it's not a probe)
+};
+
+struct circuit_breaker_stats {
+	size_t rejected{0};
+	size_t opened{0};
+	size_t closed{0};
+};
+
+// closed -> (failures) -> open -> (open_duration) -> half-open -> (probes succeeded) -> closed
+//                           ^------------------------- (probe failed) ---/
+struct circuit_breakers {
+	using clock = host_circuit::clock;
+
+	// consulted by the scheduler only when enabled
+	bool enabled{false};
+	circuit_breaker_options options{};
+
+	struct host_hash {
+		using is_transparent = void;
+
+		size_t operator()(std::string_view host) const noexcept {
+			return std::hash<std::string_view>{}(host);
+		}
+	};
+
+	std::unordered_map<std::string, host_circuit, host_hash, std::equal_to<>> hosts{};
+	circuit_breaker_stats stats{};
+	std::uint64_t half_open_periods{0};
+
+	// `now` is from the scheduler's clock (which can be simulated)
+	auto admit(std::string_view host, clock::time_point now) -> circuit_admission;
+
+	// result of an admitted transfer
+	void record(std::string_view host, std::uint64_t probe, bool failed, clock::time_point now);
+
+	// admitted transfer was cancelled before it finished
+	void abandon(std::string_view host, std::uint64_t probe) noexcept;
+
+	auto state_of(std::string_view host, clock::time_point now) const noexcept -> circuit_state;
+
+	void reset() noexcept {
+		hosts.clear();
+	}
+};
+
+} // namespace co_curl
+
+#endif
@@ -0,0 +1,612 @@
+#include "disk_cache.hpp"
+#include "easy.hpp"
+#include "list.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <future>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+static constexpr std::string_view index_magic = "co_curl-disk-cache";
+static constexpr std::uint32_t index_version = 1u;
+
+// FNV-1a, it's used only for naming objects, equality of content is always checked
+static auto content_hash(std::span<const char> data) noexcept -> std::uint64_t {
+	std::uint64_t hash = 0xcbf29ce484222325ull;
+
+	for (const char c: data) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static auto to_hex(std::uint64_t value) -> std::string {
+	constexpr std::string_view digits = "0123456789abcdef";
+	std::string output(16u, '0');
+
+	for (auto it = output.rbegin(); it != output.rend(); ++it) {
+		*it = digits[value & 0xFu];
+		value >>= 4u;
+	}
+
+	return output;
+}
+
+static auto now_in_seconds() noexcept -> std::int64_t {
+	return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static void write_all(int fd, std::span<const char> data, const std::filesystem::path & path) {
+	while (!data.empty()) {
+		const auto r = ::write(fd, data.data(), data.size());
+
+		if (r < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			throw std::system_error(errno, std::generic_category(), "can't write '" + path.string() + "'");
+		}
+
+		data = data.subspan(static_cast<size_t>(r));
+	}
+}
+
+// write into a temporary file next to the target, fsync it and rename it over the target
+static void replace_file(const std::filesystem::path & path, std::span<const char> content) {
+	auto temporary = path;
+	temporary += ".tmp";
+
+	const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), "can't open '" + temporary.string() + "'");
+	}
+
+	try {
+		write_all(fd, content, temporary);
+	} catch (...) {
+		::close(fd);
+		throw;
+	}
+
+	if (::fsync(fd) != 0) {
+		const int error = errno;
+		::close(fd);
+		throw std::system_error(error, std::generic_category(), "can't sync '" + temporary.string() + "'");
+	}
+
+	::close(fd);
+
+	if (::rename(temporary.c_str(), path.c_str()) != 0) {
+		throw std::system_error(errno, std::generic_category(), "can't rename '" + temporary.string() + "'");
+	}
+
+	// make the rename itself durable
+	if (const int dir = ::open(path.parent_path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); dir >= 0) {
+		(void)::fsync(dir);
+		::close(dir);
+	}
+}
+
+// runs on another thread, it can't touch the cache (nothing if the name is taken by different content)
+static auto write_object(const std::filesystem::path & path, std::span<const char> body) -> bool {
+	if (std::filesystem::exists(path)) {
+		try {
+			const auto existing = co_curl::mapped_file{path};
+
+			// same content is already stored
+			if (std::ranges::equal(existing.span(), body)) {
+				return true;
+			}
+
+			// it's a collision and we won't cache this one (otherwise the object is damaged and it's replaced)
+			if (existing.size() == body.size() && content_hash(existing.span()) == content_hash(body)) {
+				return false;
+			}
+		} catch (const std::system_error &) {
+			// unreadable object is replaced
+		}
+	}
+
+	replace_file(path, body);
+	return true;
+}
+
+// index format (native endianness):
+//   magic, u32 version, u64 use_counter, u64 count,
+//   count * { str key, str object, u64 size, str etag, str last_modified, i64 fresh_until, u64 last_used },
+//   u64 hash of everything before
+// where str is u32 length followed by the bytes
+
+struct index_writer {
+	std::string output{};
+
+	template <typename T> void number(T value) {
+		const auto bytes = std::bit_cast<std::array<char, sizeof(T)>>(value);
+		output.append(bytes.data(), bytes.size());
+	}
+
+	void string(std::string_view value) {
+		number(static_cast<std::uint32_t>(value.size()));
+		output.append(value);
+	}
+};
+
+struct index_reader {
+	std::string_view input;
+
+	template <typename T> bool number(T & value) noexcept {
+		if (input.size() < sizeof(T)) {
+			return false;
+		}
+
+		std::array<char, sizeof(T)> bytes{};
+		std::copy_n(input.begin(), sizeof(T), bytes.begin());
+		value = std::bit_cast<T>(bytes);
+		input.remove_prefix(sizeof(T));
+		return true;
+	}
+
+	bool string(std::string & value) {
+		std::uint32_t length = 0;
+
+		if (!number(length) || input.size() < length) {
+			return false;
+		}
+
+		value.assign(input.substr(0, length));
+		input.remove_prefix(length);
+		return true;
+	}
+};
+
+co_curl::disk_cache::disk_cache(std::filesystem::path r, disk_cache_options opts): root{std::move(r)}, options{opts} {
+	std::filesystem::create_directories(root / "objects");
+	load();
+	remove_orphans();
+
+	// limit could be lowered since the last run
+	evict_until_fits(0u);
+}
+
+co_curl::disk_cache::~disk_cache() noexcept {
+	try {
+		publish_written(true);
+		wait_for_pending_save();
+		save();
+	} catch (...) {
+		// destructor can't report anything, previous index stays valid
+	}
+}
+
+auto co_curl::disk_cache::object_path(std::string_view object) const -> std::filesystem::path {
+	return root / "objects" / object;
+}
+
+void co_curl::disk_cache::load() {
+	const auto path = root / "index";
+
+	if (!std::filesystem::exists(path)) {
+		return;
+	}
+
+	const auto file = co_curl::mapped_file{path};
+	auto content = file.view();
+
+	// damaged index is same as no index
+	if (content.size() < sizeof(std::uint64_t)) {
+		return;
+	}
+
+	auto reader = index_reader{content.substr(content.size() - sizeof(std::uint64_t))};
+	content.remove_suffix(sizeof(std::uint64_t));
+
+	if (std::uint64_t expected = 0; !reader.number(expected) || expected != content_hash(content)) {
+		return;
+	}
+
+	reader = index_reader{content};
+
+	std::string magic{};
+	std::uint32_t version = 0;
+	std::uint64_t count = 0;
+
+	if (!reader.string(magic) || magic != index_magic || !reader.number(version) || version != index_version || !reader.number(use_counter) || !reader.number(count)) {
+		use_counter = 0;
+		return;
+	}
+
+	for (std::uint64_t i = 0; i != count; ++i) {
+		std::string key{};
+		entry e{};
+		std::uint64_t size = 0;
+
+		if (!reader.string(key) || !reader.string(e.object) || !reader.number(size) || !reader.string(e.etag) || !reader.string(e.last_modified) || !reader.number(e.fresh_until) || !reader.number(e.last_used)) {
+			break;
+		}
+
+		e.size = static_cast<size_t>(size);
+
+		// object could be removed by someone else
+		std::error_code ec{};
+		if (std::filesystem::file_size(object_path(e.object), ec) != e.size || ec) {
+			dirty = true;
+			continue;
+		}
+
+		// keeps order of use from the previous run
+		insert(key, std::move(e));
+	}
+
+	use_counter = std::max(use_counter, by_use.empty() ? std::uint64_t{0} : by_use.rbegin()->first);
+}
+
+void co_curl::disk_cache::remove_orphans() {
+	for (const auto & file: std::filesystem::directory_iterator(root / "objects")) {
+		if (!object_references.contains(file.path().filename().string())) {
+			std::error_code ec{};
+			std::filesystem::remove(file.path(), ec);
+		}
+	}
+}
+
+auto co_curl::disk_cache::serialize_index() const -> std::string {
+	index_writer writer{};
+
+	writer.string(index_magic);
+	writer.number(index_version);
+	writer.number(use_counter);
+	writer.number(static_cast<std::uint64_t>(entries.size()));
+
+	for (const auto & [key, e]: entries) {
+		writer.string(key);
+		writer.string(e.object);
+		writer.number(static_cast<std::uint64_t>(e.size));
+		writer.string(e.etag);
+		writer.string(e.last_modified);
+		writer.number(e.fresh_until);
+		writer.number(e.last_used);
+	}
+
+	writer.number(content_hash(writer.output));
+	return std::move(writer.output);
+}
+
+void co_curl::disk_cache::wait_for_pending_save() {
+	if (!pending_save.valid()) {
+		return;
+	}
+
+	try {
+		pending_save.get();
+	} catch (const std::system_error &) {
+		// the index on the disk is the previous one
+		dirty = true;
+		throw;
+	}
+}
+
+void co_curl::disk_cache::save() {
+	publish_written();
+	wait_for_pending_save();
+
+	if (!dirty) {
+		return;
+	}
+
+	replace_file(root / "index", serialize_index());
+	dirty = false;
+}
+
+void co_curl::disk_cache::save_in_background() {
+	// index only points to objects which are already synced
+	publish_written();
+
+	if (!dirty) {
+		return;
+	}
+
+	// one write at a time, changes meanwhile are batched into the next one
+	if (pending_save.valid()) {
+		if (pending_save.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+			return;
+		}
+
+		wait_for_pending_save();
+	}
+
+	pending_save = std::async(std::launch::async, [path = root / "index", content = serialize_index()] { replace_file(path, content); });
+	dirty = false;
+}
+
+bool co_curl::disk_cache::is_fresh(const entry & e) noexcept {
+	return now_in_seconds() < e.fresh_until;
+}
+
+auto co_curl::disk_cache::find(const std::string & key) -> const entry * {
+	publish_written();
+
+	const auto it = entries.find(key);
+
+	if (it == entries.end()) {
+		return nullptr;
+	}
+
+	// order of use is persisted with next save
+	by_use.erase(it->second.last_used);
+	it->second.last_used = ++use_counter;
+	by_use[it->second.last_used] = key;
+	dirty = true;
+
+	return &it->second;
+}
+
+auto co_curl::disk_cache::map(const std::string & key) -> std::optional<mapped_file> {
+	const auto it = entries.find(key);
+
+	if (it == entries.end()) {
+		return std::nullopt;
+	}
+
+	try {
+		auto file = co_curl::mapped_file{object_path(it->second.object)};
+
+		if (file.size() == it->second.size) {
+			return file;
+		}
+	} catch (const std::system_error &) {
+		// fall through and forget the entry
+	}
+
+	erase(key);
+	return std::nullopt;
+}
+
+void co_curl::disk_cache::insert(const std::string & key, entry e) {
+	if (++object_references[e.object] == 1u) {
+		used_bytes += e.size;
+	}
+
+	by_use[e.last_used] = key;
+	entries.insert_or_assign(key, std::move(e));
+	dirty = true;
+}
+
+void co_curl::disk_cache::release_object(const std::string & object, size_t size) {
+	const auto it = object_references.find(object);
+
+	if (it == object_references.end() || --it->second != 0u) {
+		return;
+	}
+
+	object_references.erase(it);
+
+	used_bytes -= size;
+
+	std::error_code ec{};
+	std::filesystem::remove(object_path(object), ec);
+}
+
+void co_curl::disk_cache::erase(const std::string & key) {
+	// body which is still being written would bring the entry back
+	for (pending_store & p: pending_stores) {
+		p.superseded |= (p.key == key);
+	}
+
+	const auto it = entries.find(key);
+
+	if (it == entries.end()) {
+		return;
+	}
+
+	const std::string object = std::move(it->second.object);
+	const size_t size = it->second.size;
+
+	by_use.erase(it->second.last_used);
+	entries.erase(it);
+	release_object(object, size);
+	dirty = true;
+}
+
+void co_curl::disk_cache::evict_until_fits(size_t needed) {
+	// most recent entry is never evicted
+	while (by_use.size() > 1u && used_bytes + needed > options.max_bytes) {
+		// copy as erase() destroys the item
+		const std::string oldest = by_use.begin()->second;
+		erase(oldest);
+		++stats.evictions;
+	}
+}
+
+void co_curl::disk_cache::store(const std::string & key, std::span<const char> body, const cache_headers & headers) {
+	if (body.size() > options.max_bytes) {
+		erase(key);
+		return;
+	}
+
+	for (pending_store & p: pending_stores) {
+		p.superseded |= (p.key == key);
+	}
+
+	auto write = [objects = root / "objects", content = std::string(body.begin(), body.end())]() -> std::optional<std::string> {
+		// unchanged body gets the same object name
+		std::string name = to_hex(content_hash(content)) + "-" + to_hex(content.size());
+
+		if (!write_object(objects / name, content)) {
+			return std::nullopt;
+		}
+
+		return name;
+	};
+
+	pending_stores.push_back(pending_store{
+		.key = key,
+		.metadata = entry{
+			.size = body.size(),
+			.etag = headers.etag,
+			.last_modified = headers.last_modified,
+			.fresh_until = now_in_seconds() + headers.freshness().count(),
+		},
+		.object = std::async(std::launch::async, std::move(write)),
+	});
+}
+
+void co_curl::disk_cache::publish_written(bool wait) {
+	// in order of store() so an older body never replaces a newer one
+	while (!pending_stores.empty()) {
+		pending_store & p = pending_stores.front();
+
+		if (!wait && p.object.wait_for(std::chrono::seconds{0}) != std::future_status::ready) {
+			return;
+		}
+
+		std::optional<std::string> object{};
+
+		try {
+			object = p.object.get();
+		} catch (const std::system_error &) {
+			// the cache is only an optimization, a full disk shouldn't fail anything
+		}
+
+		// the object could be removed meanwhile by release of an entry which had the same body
+		std::error_code ec{};
+
+		if (object && !p.superseded && std::filesystem::file_size(object_path(*object), ec) == p.metadata.size && !ec) {
+			std::optional<entry> previous{};
+
+			if (const auto it = entries.find(p.key); it != entries.end()) {
+				previous = std::move(it->second);
+				by_use.erase(previous->last_used);
+				entries.erase(it);
+			}
+
+			// new reference is taken before the old one is released, so an unchanged object isn't removed
+			p.metadata.object = std::move(*object);
+			p.metadata.last_used = ++use_counter;
+			insert(p.key, std::move(p.metadata));
+
+			if (previous) {
+				release_object(previous->object, previous->size);
+			}
+
+			evict_until_fits(0u);
+		}
+
+		pending_stores.pop_front();
+	}
+}
+
+void co_curl::disk_cache::refresh(const std::string & key, const cache_headers & headers) {
+	const auto it = entries.find(key);
+
+	if (it == entries.end()) {
+		return;
+	}
+
+	// 304 can carry updated validators
+	if (!headers.etag.empty()) {
+		it->second.etag = headers.etag;
+	}
+
+	if (!headers.last_modified.empty()) {
+		it->second.last_modified = headers.last_modified;
+	}
+
+	it->second.fresh_until = now_in_seconds() + headers.freshness().count();
+	dirty = true;
+}
+
+auto co_curl::fetch(disk_cache & cache, std::string url) -> co_curl::promise<cached_body> {
+	const auto key = response_cache::normalize(url);
+
+	std::string etag{};
+	std::string last_modified{};
+	bool revalidate = false;
+
+	if (const auto * e = cache.find(key)) {
+		if (disk_cache::is_fresh(*e)) {
+			if (auto file = cache.map(key)) {
+				++cache.stats.hits;
+				co_return cached_body{.mapping = std::move(*file), .from_cache = true};
+			}
+		} else {
+			// copied as the entry can disappear while we are waiting
+			etag = e->etag;
+			last_modified = e->last_modified;
+			revalidate = true;
+		}
+	}
+
+	for (;;) {
+		auto handle = co_curl::easy_handle{url};
+		auto conditional = co_curl::list{};
+
+		if (revalidate) {
+			if (!etag.empty()) {
+				conditional.append("If-None-Match: " + etag);
+			}
+
+			if (!last_modified.empty()) {
+				conditional.append("If-Modified-Since: " + last_modified);
+			}
+
+			handle.http_headers(conditional);
+		}
+
+		std::string output{};
+		cache_headers headers{};
+
+		handle.follow_location();
+		handle.write_into(output);
+		handle.header_callback(headers);
+		handle.connection_timeout(std::chrono::seconds{2});
+
+		if (const auto r = co_await handle.perform(); !r) {
+			throw std::runtime_error(std::string{"couldn't download a file: "}.append(url) + " (reason: " + r.c_str() + ")");
+		}
+
+		const unsigned code = handle.get_response_code();
+
+		if (code == 304u && revalidate) {
+			cache.refresh(key, headers);
+
+			try {
+				cache.save_in_background();
+			} catch (const std::system_error &) {
+				// previous index stays valid, it's written again with next save
+			}
+
+			if (auto file = cache.map(key)) {
+				++cache.stats.revalidated;
+				co_return cached_body{.mapping = std::move(*file), .from_cache = true};
+			}
+
+			// object is gone, ask for the whole body
+			revalidate = false;
+			continue;
+		}
+
+		++cache.stats.misses;
+
+		try {
+			if (code == 200u && !headers.control.no_store && (headers.freshness().count() > 0 || headers.has_validators())) {
+				cache.store(key, output, headers);
+			} else if (revalidate) {
+				// entry is not valid anymore
+				cache.erase(key);
+			}
+
+			cache.save_in_background();
+		} catch (const std::system_error &) {
+			// the cache is only an optimization, a full disk shouldn't fail the transfer
+		}
+
+		co_return cached_body{.owned = std::move(output)};
+	}
+}
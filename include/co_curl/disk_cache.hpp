@@ -0,0 +1,143 @@
+#ifndef CO_CURL_DISK_CACHE_HPP
+#define CO_CURL_DISK_CACHE_HPP
+
+#include "mapped_file.hpp"
+#include "promise.hpp"
+#include "response_cache.hpp"
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace co_curl {
+
+struct disk_cache_options {
+	// sum of sizes of all stored bodies
+	size_t max_bytes{size_t{1024u} * 1024u * 1024u};
+};
+
+struct disk_cache_stats {
+	size_t hits{0};
+	size_t revalidated{0};
+	size_t misses{0};
+	size_t evictions{0};
+};
+
+// response body, mapped from the cache or owned when it was just downloaded
+struct cached_body {
+	mapped_file mapping{};
+	std::string owned{};
+	bool from_cache{false};
+
+	auto view() const noexcept -> std::string_view {
+		return from_cache ? mapping.view() : std::string_view{owned};
+	}
+
+	auto span() const noexcept -> std::span<const char> {
+		const auto v = view();
+		return {v.data(), v.size()};
+	}
+
+	const char * data() const noexcept {
+		return view().data();
+	}
+
+	size_t size() const noexcept {
+		return view().size();
+	}
+
+	operator std::string_view() const noexcept {
+		return view();
+	}
+};
+
+// persistent cache of response bodies in a directory:
+//  - bodies are in `objects/` named by hash and size of the content (same bodies are stored once)
+//  - `index` maps normalized URL to the object and its validators, it's replaced atomically
+//    (written aside, fsynced, renamed) so a crash leaves either the old or the new one
+// only one process should use a directory at a time, the object is not thread-safe
+struct disk_cache {
+	struct entry {
+		std::string object{};
+		size_t size{0};
+		std::string etag{};
+		std::string last_modified{};
+		std::int64_t fresh_until{0}; // seconds since epoch
+		std::uint64_t last_used{0};
+	};
+
+	// object being written by another thread, its entry is inserted once it's on the disk
+	struct pending_store {
+		std::string key{};
+		entry metadata{};
+		std::future<std::optional<std::string>> object{};
+		bool superseded{false};
+	};
+
+	std::filesystem::path root;
+	disk_cache_options options;
+
+	std::unordered_map<std::string, entry> entries{};
+	std::map<std::uint64_t, std::string> by_use{}; // oldest first
+	std::unordered_map<std::string, unsigned> object_references{};
+	std::uint64_t use_counter{0};
+	size_t used_bytes{0};
+	bool dirty{false};
+	std::future<void> pending_save{};
+	std::deque<pending_store> pending_stores{}; // in order of store()
+
+	disk_cache_stats stats{};
+
+	// loads the index and removes objects which are not in it (leftovers after a crash)
+	explicit disk_cache(std::filesystem::path root, disk_cache_options options = {});
+	disk_cache(const disk_cache &) = delete;
+	disk_cache & operator=(const disk_cache &) = delete;
+	~disk_cache() noexcept;
+
+	// marks the entry as recently used
+	auto find(const std::string & key) -> const entry *;
+
+	// nothing if the object is missing or damaged (the entry is removed)
+	auto map(const std::string & key) -> std::optional<mapped_file>;
+
+	// the body is copied, written and synced by another thread and the entry is visible after that
+	// (a body which can't be written is just not cached)
+	void store(const std::string & key, std::span<const char> body, const cache_headers & headers);
+	void refresh(const std::string & key, const cache_headers & headers);
+	void erase(const std::string & key);
+
+	// write the index if it changed (also called from the destructor after all pending stores)
+	void save();
+
+	// same, but the index is written and synced by another thread, changes made meanwhile go with next save
+	// (called by fetch after every change, so it doesn't block the event loop)
+	void save_in_background();
+
+	static bool is_fresh(const entry & e) noexcept;
+
+	// internals
+	auto object_path(std::string_view object) const -> std::filesystem::path;
+	void load();
+	auto serialize_index() const -> std::string;
+	void wait_for_pending_save();
+	void publish_written(bool wait = false);
+	void remove_orphans();
+	void evict_until_fits(size_t needed);
+	void insert(const std::string & key, entry e); // with `last_used` already set
+	void release_object(const std::string & object, size_t size);
+};
+
+// fresh entries are served mapped from the disk, stale are revalidated with If-None-Match/If-Modified-Since
+auto fetch(disk_cache & cache, std::string url) -> co_curl::promise<cached_body>;
+
+} // namespace co_curl
+
+#endif
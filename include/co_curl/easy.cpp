@@ -1,5 +1,6 @@
 #include "easy.hpp"
 #include "out_ptr.hpp"
+#include <algorithm>
 #include <curl/curl.h>
 
 co_curl::result::operator bool() const noexcept {
@@ -10,8 +11,18 @@ co_curl::result::operator std::string_view() const noexcept {
 	return std::string_view(c_str());
 }
 
+// codes of co_curl are negative, so they never collide with libcurl's
+static constexpr int circuit_open_code = -1;
+
+static_assert(co_curl::write_pause == CURL_WRITEFUNC_PAUSE);
+
 const char * co_curl::result::c_str() const noexcept {
 	static_assert(sizeof(CURLcode) == sizeof(code));
+
+	if (code == circuit_open_code) {
+		return "Circuit breaker is open for the host";
+	}
+
 	return curl_easy_strerror(static_cast<CURLcode>(code));
 }
 
@@ -27,6 +38,34 @@ bool co_curl::result::is_range_error() const noexcept {
 	return code == CURLE_RANGE_ERROR;
 }
 
+bool co_curl::result::is_aborted_by_callback() const noexcept {
+	return code == CURLE_ABORTED_BY_CALLBACK;
+}
+
+auto co_curl::result::partial_transfer() noexcept -> result {
+	return result{.code = CURLE_PARTIAL_FILE};
+}
+
+bool co_curl::result::is_circuit_open() const noexcept {
+	return code == circuit_open_code;
+}
+
+auto co_curl::result::circuit_open() noexcept -> result {
+	return result{.code = circuit_open_code};
+}
+
+bool co_curl::result::is_connection_error() const noexcept {
+	switch (code) {
+	case CURLE_COULDNT_CONNECT:
+	case CURLE_SEND_ERROR:
+	case CURLE_RECV_ERROR:
+	case CURLE_GOT_NOTHING:
+		return true;
+	default:
+		return false;
+	}
+}
+
 co_curl::easy_handle::easy_handle(): native_handle{curl_easy_init()} { }
 
 co_curl::easy_handle::~easy_handle() noexcept {
@@ -38,11 +77,13 @@ co_curl::easy_handle::~easy_handle() noexcept {
 auto co_curl::easy_handle::duplicate() const -> easy_handle {
 	auto out = easy_handle{nullptr};
 	out.native_handle = curl_easy_duphandle(native_handle);
+	out.verbose_enabled = verbose_enabled;
 	return out;
 }
 
 void co_curl::easy_handle::reset() noexcept {
 	curl_easy_reset(native_handle);
+	verbose_enabled = false;
 }
 
 auto co_curl::easy_handle::sync_perform() noexcept -> result {
@@ -70,6 +111,7 @@ void co_curl::easy_handle::follow_location(bool enable) noexcept {
 }
 
 void co_curl::easy_handle::verbose(bool enable) noexcept {
+	verbose_enabled = enable;
 	curl_easy_setopt(native_handle, CURLOPT_VERBOSE, static_cast<long>(enable));
 }
 
@@ -124,6 +166,25 @@ void co_curl::easy_handle::disable_resume() noexcept {
 	resume(0u);
 }
 
+void co_curl::easy_handle::range(size_t first, size_t last) {
+	// curl copies the string
+	const auto r = std::to_string(first).append("-").append(std::to_string(last));
+	curl_easy_setopt(native_handle, CURLOPT_RANGE, r.c_str());
+}
+
+void co_curl::easy_handle::range(size_t first) {
+	const auto r = std::to_string(first).append("-");
+	curl_easy_setopt(native_handle, CURLOPT_RANGE, r.c_str());
+}
+
+void co_curl::easy_handle::disable_range() noexcept {
+	curl_easy_setopt(native_handle, CURLOPT_RANGE, nullptr);
+}
+
+void co_curl::easy_handle::no_body(bool enable) noexcept {
+	curl_easy_setopt(native_handle, CURLOPT_NOBODY, static_cast<long>(enable));
+}
+
 void co_curl::easy_handle::connection_timeout(std::chrono::milliseconds duration) noexcept {
 	curl_easy_setopt(native_handle, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(duration.count()));
 }
@@ -137,6 +198,14 @@ void co_curl::easy_handle::low_speed_timeout(size_t bytes_per_second, std::chron
 	low_speed_timeout(duration, bytes_per_second);
 }
 
+void co_curl::easy_handle::max_recv_speed(size_t bytes_per_second) noexcept {
+	curl_easy_setopt(native_handle, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(bytes_per_second));
+}
+
+void co_curl::easy_handle::max_send_speed(size_t bytes_per_second) noexcept {
+	curl_easy_setopt(native_handle, CURLOPT_MAX_SEND_SPEED_LARGE, static_cast<curl_off_t>(bytes_per_second));
+}
+
 void co_curl::easy_handle::set_coroutine_handle(std::coroutine_handle<void> h) noexcept {
 	curl_easy_setopt(native_handle, CURLOPT_PRIVATE, h.address());
 }
@@ -167,6 +236,14 @@ void co_curl::easy_handle::read_data(void * udata) noexcept {
 	curl_easy_setopt(native_handle, CURLOPT_READDATA, udata);
 }
 
+void co_curl::easy_handle::header_function(size_t (*f)(char *, size_t, size_t, void *)) noexcept {
+	curl_easy_setopt(native_handle, CURLOPT_HEADERFUNCTION, f);
+}
+
+void co_curl::easy_handle::header_data(void * udata) noexcept {
+	curl_easy_setopt(native_handle, CURLOPT_HEADERDATA, udata);
+}
+
 auto co_curl::easy_handle::get_content_type() const noexcept -> std::optional<std::string_view> {
 	out_ptr<char, non_owning> out{};
 
@@ -189,6 +266,11 @@ auto co_curl::easy_handle::get_content_length() const noexcept -> std::optional<
 		return std::nullopt;
 	}
 
+	// unknown length is reported as -1
+	if (cl < 0) {
+		return std::nullopt;
+	}
+
 	return static_cast<size_t>(cl);
 }
 #endif
@@ -200,3 +282,79 @@ auto co_curl::easy_handle::get_response_code() const noexcept -> unsigned {
 
 	return static_cast<unsigned>(rc);
 }
+
+auto co_curl::easy_handle::get_retry_after() const noexcept -> std::optional<std::chrono::seconds> {
+#if LIBCURL_VERSION_NUM >= 0x074200
+	curl_off_t seconds{0};
+
+	if (CURLE_OK != curl_easy_getinfo(native_handle, CURLINFO_RETRY_AFTER, &seconds)) {
+		return std::nullopt;
+	}
+
+	// zero means there was no Retry-After header
+	if (seconds <= 0) {
+		return std::nullopt;
+	}
+
+	return std::chrono::seconds{seconds};
+#else
+	return std::nullopt;
+#endif
+}
+
+auto co_curl::easy_handle::get_time_to_first_byte() const noexcept -> std::optional<std::chrono::microseconds> {
+	curl_off_t us{0};
+
+	if (CURLE_OK != curl_easy_getinfo(native_handle, CURLINFO_STARTTRANSFER_TIME_T, &us)) {
+		return std::nullopt;
+	}
+
+	return std::chrono::microseconds{us};
+}
+
+static auto get_time(CURL * handle, CURLINFO info) noexcept -> std::chrono::microseconds {
+	curl_off_t us{0};
+	curl_easy_getinfo(handle, info, &us);
+	return std::chrono::microseconds{us};
+}
+
+static auto get_size(CURL * handle, CURLINFO info) noexcept -> size_t {
+	curl_off_t bytes{0};
+	curl_easy_getinfo(handle, info, &bytes);
+	return static_cast<size_t>(std::max<curl_off_t>(bytes, 0));
+}
+
+static auto get_count(CURL * handle, CURLINFO info) noexcept -> unsigned {
+	long count{0};
+	curl_easy_getinfo(handle, info, &count);
+	return static_cast<unsigned>(std::max(count, 0L));
+}
+
+auto co_curl::easy_handle::get_transfer_stats() const noexcept -> transfer_stats {
+	return transfer_stats{
+		.name_lookup = get_time(native_handle, CURLINFO_NAMELOOKUP_TIME_T),
+		.connect = get_time(native_handle, CURLINFO_CONNECT_TIME_T),
+		.tls_handshake = get_time(native_handle, CURLINFO_APPCONNECT_TIME_T),
+		.pretransfer = get_time(native_handle, CURLINFO_PRETRANSFER_TIME_T),
+		.start_transfer = get_time(native_handle, CURLINFO_STARTTRANSFER_TIME_T),
+		.total = get_time(native_handle, CURLINFO_TOTAL_TIME_T),
+		.redirect = get_time(native_handle, CURLINFO_REDIRECT_TIME_T),
+		.bytes_downloaded = get_size(native_handle, CURLINFO_SIZE_DOWNLOAD_T),
+		.bytes_uploaded = get_size(native_handle, CURLINFO_SIZE_UPLOAD_T),
+		.redirects = get_count(native_handle, CURLINFO_REDIRECT_COUNT),
+		.new_connections = get_count(native_handle, CURLINFO_NUM_CONNECTS),
+	};
+}
+
+std::ostream & co_curl::operator<<(std::ostream & os, const transfer_stats & s) {
+	const auto ms = [](std::chrono::microseconds d) { return static_cast<double>(d.count()) / 1000.0; };
+
+	os << "dns " << ms(s.dns()) << " ms, tcp " << ms(s.tcp()) << " ms, tls " << ms(s.tls()) << " ms, server " << ms(s.server()) << " ms, content " << ms(s.content()) << " ms, total " << ms(s.total) << " ms";
+	os << ", " << s.bytes_downloaded << " B down, " << s.bytes_uploaded << " B up";
+
+	if (s.redirects != 0u) {
+		os << ", " << s.redirects << " redirects (" << ms(s.redirect) << " ms)";
+	}
+
+	return os << (s.connection_reused() ? ", reused connection" : ", new connection");
+}
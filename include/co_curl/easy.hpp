@@ -19,6 +19,9 @@ namespace co_curl {
 
 struct perform;
 
+// returned from a write callback to pause the transfer (CURL_WRITEFUNC_PAUSE), same data is delivered after unpausing
+inline constexpr size_t write_pause = 0x10000001u;
+
 struct result {
 	int code;
 
@@ -33,16 +36,80 @@ struct result {
 	bool is_partial_transfer() const noexcept;
 	bool is_timeout() const noexcept;
 	bool is_range_error() const noexcept;
+	bool is_connection_error() const noexcept;
+	bool is_circuit_open() const noexcept;
+	bool is_aborted_by_callback() const noexcept;
+
+	static auto partial_transfer() noexcept -> result;
+
+	// transfer was rejected without trying as its host is failing (not a libcurl's code)
+	static auto circuit_open() noexcept -> result;
 };
 
+// what libcurl measured during the last transfer of a handle, times are from the start of the transfer (with redirects
+// followed they include all previous requests), phases are computed from them
+struct transfer_stats {
+	using duration = std::chrono::microseconds;
+
+	duration name_lookup{};
+	duration connect{};
+	duration tls_handshake{}; // zero without TLS
+	duration pretransfer{};
+	duration start_transfer{};
+	duration total{};
+	duration redirect{};
+
+	size_t bytes_downloaded{0};
+	size_t bytes_uploaded{0};
+	unsigned redirects{0};
+	unsigned new_connections{0};
+
+	bool connection_reused() const noexcept {
+		return new_connections == 0u;
+	}
+
+	// phases
+	auto dns() const noexcept -> duration {
+		return name_lookup;
+	}
+
+	// zero for reused connections
+	auto tcp() const noexcept -> duration {
+		return between(name_lookup, connect);
+	}
+
+	auto tls() const noexcept -> duration {
+		return between(connect, tls_handshake);
+	}
+
+	// time the server needed to respond after the request was sent
+	auto server() const noexcept -> duration {
+		return between(pretransfer, start_transfer);
+	}
+
+	auto content() const noexcept -> duration {
+		return between(start_transfer, total);
+	}
+
+	// libcurl reports zero for steps which didn't happen
+	static constexpr auto between(duration from, duration to) noexcept -> duration {
+		return (to > from) ? to - from : duration{};
+	}
+};
+
+std::ostream & operator<<(std::ostream & os, const transfer_stats & s);
+
 struct easy_handle {
 	CURL * native_handle;
 
+	// libcurl can't be asked for its options, the exchange recorder restores this one after recording
+	bool verbose_enabled{false};
+
 	// constructors
 	explicit constexpr easy_handle(std::nullptr_t) noexcept: native_handle{nullptr} { }
 	easy_handle();
 	easy_handle(const easy_handle &) = delete;
-	constexpr easy_handle(easy_handle && other) noexcept: native_handle{std::exchange(other.native_handle, nullptr)} { }
+	constexpr easy_handle(easy_handle && other) noexcept: native_handle{std::exchange(other.native_handle, nullptr)}, verbose_enabled{other.verbose_enabled} { }
 
 	// helper constructors
 	easy_handle(const char * u): easy_handle() {
@@ -65,6 +132,7 @@ struct easy_handle {
 
 	constexpr easy_handle & operator=(easy_handle && rhs) noexcept {
 		std::swap(native_handle, rhs.native_handle);
+		std::swap(verbose_enabled, rhs.verbose_enabled);
 		return *this;
 	}
 
@@ -100,11 +168,22 @@ struct easy_handle {
 	void resume(size_t position) noexcept;
 	void disable_resume() noexcept;
 
+	// inclusive range of bytes [first, last], or everything from `first`
+	void range(size_t first, size_t last);
+	void range(size_t first);
+	void disable_range() noexcept;
+
+	void no_body(bool enable = true) noexcept;
+
 	void connection_timeout(std::chrono::milliseconds duration) noexcept;
 
 	void low_speed_timeout(std::chrono::seconds duration, size_t bytes_per_second) noexcept;
 	void low_speed_timeout(size_t bytes_per_second, std::chrono::seconds duration) noexcept;
 
+	// zero means unlimited (it can be changed while the transfer is running)
+	void max_recv_speed(size_t bytes_per_second) noexcept;
+	void max_send_speed(size_t bytes_per_second) noexcept;
+
 	// support for scheduler
 	void set_coroutine_handle(std::coroutine_handle<void>) noexcept;
 	auto get_coroutine_handle() noexcept -> std::coroutine_handle<void>;
@@ -113,12 +192,19 @@ struct easy_handle {
 	auto get_content_type() const noexcept -> std::optional<std::string_view>;
 	auto get_content_length() const noexcept -> std::optional<size_t>;
 	auto get_response_code() const noexcept -> unsigned;
+	auto get_retry_after() const noexcept -> std::optional<std::chrono::seconds>;
+	auto get_time_to_first_byte() const noexcept -> std::optional<std::chrono::microseconds>;
+
+	// valid after the transfer finished (until the next one is started)
+	auto get_transfer_stats() const noexcept -> transfer_stats;
 
 	// write/read
 	void write_function(size_t (*)(char *, size_t, size_t, void *)) noexcept;
 	void write_data(void *) noexcept;
 	void read_function(size_t (*)(char *, size_t, size_t, void *)) noexcept;
 	void read_data(void *) noexcept;
+	void header_function(size_t (*)(char *, size_t, size_t, void *)) noexcept;
+	void header_data(void *) noexcept;
 
 	// extended callbacks
 	template <typename T, std::invocable<T> F> void write_callback(F & f) {
@@ -157,14 +243,46 @@ struct easy_handle {
 
 			const auto * ptr = reinterpret_cast<const value_type *>(const_cast<const char *>(in));
 
-			std::copy(ptr, ptr + nmemb, std::back_inserter(o));
-
-			return nmemb;
+			try {
+				// containers which can't take more data now (they unpause the transfer later)
+				if constexpr (requires { { o.pause_writes() } -> std::convertible_to<bool>; }) {
+					if (o.pause_writes()) {
+						return write_pause;
+					}
+				}
+
+				// containers which can take whole chunk at once (std::string, co_curl::buffer_chain, ...)
+				if constexpr (requires { o.append(ptr, nmemb); }) {
+					o.append(ptr, nmemb);
+				} else {
+					std::copy(ptr, ptr + nmemb, std::back_inserter(o));
+				}
+				return nmemb;
+			} catch (...) {
+				return size_t(-1);
+			}
 		});
 
 		write_data(&out);
 	}
 
+	// called with each header line (including status line and CRLF)
+	template <typename F> void header_callback(F & f) requires(std::invocable<F &, std::string_view>) {
+		using fnc_t = F;
+
+		header_function(+[](char * in, size_t, size_t nitems, void * udata) -> size_t {
+			fnc_t & f2 = *static_cast<fnc_t *>(udata);
+			try {
+				f2(std::string_view(in, nitems));
+				return nitems;
+			} catch (...) {
+				return size_t(-1);
+			}
+		});
+
+		header_data(&f);
+	}
+
 	void write_nowhere() noexcept {
 		write_function(+[](char *, size_t, size_t nmemb, void *) -> size_t { return nmemb; });
 	}
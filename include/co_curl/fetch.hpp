@@ -1,14 +1,35 @@
 #ifndef CO_CURL_FETCH_HPP
 #define CO_CURL_FETCH_HPP
 
+#include "buffer_chain.hpp"
 #include "easy.hpp"
+#include "promise.hpp"
+#include "retry_policy.hpp"
+#include "scheduler.hpp"
+#include <limits>
 
 namespace co_curl {
 
-template <typename Container = std::string> auto fetch(std::string_view url, int attempts = 5) -> co_curl::promise<Container> {
+// pooled buffers are leased from scheduler's pool, everything else is just constructed
+template <typename Container, typename Scheduler = default_scheduler> auto make_output_container() -> Container {
+	if constexpr (std::same_as<Container, pooled_buffer>) {
+		return get_scheduler<Scheduler>().buffers.lease();
+	} else {
+		return Container{};
+	}
+}
+
+// shared by all fetches without their own policy (attempts are limited by each call), so its budget protects against retry storms
+template <typename Scheduler = default_scheduler> auto get_default_retry_policy() -> retry_policy & {
+	static retry_policy default_policy{.max_attempts = std::numeric_limits<unsigned>::max()};
+	return default_policy;
+}
+
+// `max_attempts` limits this transfer further than policy does
+template <typename Container = std::string, typename Scheduler = default_scheduler> auto fetch(std::string_view url, retry_policy & policy, unsigned max_attempts) -> co_curl::promise<Container, Scheduler> {
 	auto handle = co_curl::easy_handle{url};
 
-	Container output;
+	Container output = make_output_container<Container, Scheduler>();
 
 	handle.verbose();
 	handle.follow_location();
@@ -16,32 +37,52 @@ template <typename Container = std::string> auto fetch(std::string_view url, int
 	handle.connection_timeout(std::chrono::seconds{2});
 	handle.low_speed_timeout(100, std::chrono::seconds{1});
 
-	for (;;) {
+	for (unsigned attempt = 0;; ++attempt) {
 		auto r = co_await handle.perform();
 
-		if (!r) {
-			if (r.is_range_error()) {
-				output.clear();
-				handle.disable_resume();
-				continue;
-			}
+		if (r.is_range_error()) {
+			output.clear();
+			handle.disable_resume();
+			continue;
+		}
 
-			if (attempts-- > 0) {
-				handle.resume(output.size());
-				continue;
+		if (r && !retry_policy::is_retryable_http_code(handle.get_response_code())) {
+			policy.record_success();
+			co_return output;
+		}
+
+		const auto delay = attempt < max_attempts ? policy.should_retry(handle, r, attempt) : std::nullopt;
+
+		if (!delay) {
+			// out of attempts with an error response, it's up to the caller to check it
+			if (r) {
+				co_return output;
 			}
 
 			throw std::runtime_error(std::string{"couldn't download a file: "}.append(handle.url()) + " (reason: " + r.c_str() + ")");
 		}
 
-		// if (handle.get_response_code() != co_curl::http_2XX) {
-		//	throw std::runtime_error(std::string{"url doesn't return HTTP 2xx response: "}.append(handle.url()));
-		// }
+		if (r) {
+			// body of an error response is not part of the document
+			output.clear();
+			handle.disable_resume();
+		} else {
+			handle.resume(output.size());
+		}
 
-		co_return output;
+		// other coroutines and transfers continue meanwhile
+		co_await co_curl::sleep_for(*delay);
 	}
 }
 
+template <typename Container = std::string, typename Scheduler = default_scheduler> auto fetch(std::string_view url, retry_policy & policy) -> co_curl::promise<Container, Scheduler> {
+	return fetch<Container, Scheduler>(url, policy, policy.max_attempts);
+}
+
+template <typename Container = std::string, typename Scheduler = default_scheduler> auto fetch(std::string_view url, int attempts = 5) -> co_curl::promise<Container, Scheduler> {
+	return fetch<Container, Scheduler>(url, get_default_retry_policy<Scheduler>(), static_cast<unsigned>(std::max(attempts, 0)));
+}
+
 } // namespace co_curl
 
 #endif
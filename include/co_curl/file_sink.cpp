@@ -0,0 +1,243 @@
+#include "file_sink.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <curl/curl.h>
+
+struct co_curl::write_behind_state {
+	std::mutex mutex{};
+	std::condition_variable cv{};
+	size_t outstanding_bytes{0};
+	size_t limit{0};
+	int error{0};
+
+	// transfer writing into the sink and whether it's paused, changed only by the loop (under the mutex)
+	CURL * handle{nullptr};
+	bool paused{false};
+	bool unpause_posted{false};
+
+	std::function<void(std::function<void()>)> post_to_loop{};
+};
+
+// called by the loop
+static void unpause(const std::shared_ptr<co_curl::write_behind_state> & state) noexcept {
+	CURL * handle = nullptr;
+
+	{
+		auto lock = std::unique_lock(state->mutex);
+		state->unpause_posted = false;
+
+		if (!state->paused || state->handle == nullptr) {
+			return;
+		}
+
+		state->paused = false;
+		handle = state->handle;
+	}
+
+	// libcurl delivers the held data right away, which can pause the transfer again
+	(void)curl_easy_pause(handle, CURLPAUSE_CONT);
+}
+
+static auto write_behind(co_curl::thread_pool &, std::shared_ptr<co_curl::write_behind_state> state, int fd, std::string data, size_t offset) -> co_curl::pool_job {
+	int error = 0;
+
+	for (size_t written = 0; written < data.size();) {
+		const auto r = ::pwrite(fd, data.data() + written, data.size() - written, static_cast<off_t>(offset + written));
+
+		if (r < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			error = errno;
+			break;
+		}
+
+		written += static_cast<size_t>(r);
+	}
+
+	bool post_unpause = false;
+
+	{
+		auto lock = std::unique_lock(state->mutex);
+		state->outstanding_bytes -= data.size();
+
+		if (error != 0 && state->error == 0) {
+			state->error = error;
+		}
+
+		// with an error the transfer is unpaused too, so it fails on the next write
+		if (state->paused && !state->unpause_posted && (state->outstanding_bytes < state->limit || state->error != 0)) {
+			state->unpause_posted = true;
+			post_unpause = true;
+		}
+	}
+
+	state->cv.notify_all();
+
+	if (post_unpause) {
+		try {
+			state->post_to_loop([state] { unpause(state); });
+		} catch (...) {
+			// loop can't be reached, the transfer will time out
+		}
+	}
+
+	co_return;
+}
+
+co_curl::file_sink::file_sink(thread_pool & p, const std::filesystem::path & path, file_sink_options opts): pool{p}, options{opts}, position{opts.offset}, state{std::make_shared<write_behind_state>()} {
+	fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), "can't open '" + path.string() + "'");
+	}
+
+	if (options.truncate && ::ftruncate(fd, static_cast<off_t>(options.offset)) != 0) {
+		const int error = errno;
+		::close(fd);
+		throw std::system_error(error, std::generic_category(), "can't truncate '" + path.string() + "'");
+	}
+
+	buffer.reserve(options.chunk_size);
+
+	state->limit = options.max_outstanding_bytes;
+	state->post_to_loop = options.post_to_loop ? options.post_to_loop : [](std::function<void()> fn) { get_scheduler().waiting.post(std::move(fn)); };
+}
+
+co_curl::file_sink::~file_sink() noexcept {
+	{
+		// posted unpause must not touch the handle anymore
+		auto lock = std::unique_lock(state->mutex);
+		state->handle = nullptr;
+		state->paused = false;
+	}
+
+	try {
+		submit_buffer();
+	} catch (...) {
+		// destructor can't report anything
+	}
+
+	// jobs in the thread_pool are still using the descriptor
+	(void)drain();
+	::close(fd);
+}
+
+void co_curl::file_sink::attach(easy_handle & handle) {
+	attached = &handle;
+	preallocated = false;
+
+	{
+		auto lock = std::unique_lock(state->mutex);
+		state->handle = handle.native_handle;
+	}
+
+	handle.write_into(*this);
+}
+
+bool co_curl::file_sink::preallocate([[maybe_unused]] size_t total_size) noexcept {
+#ifdef __linux__
+	// unlike posix_fallocate() it never falls back to writing zeros
+	return ::fallocate(fd, 0, 0, static_cast<off_t>(total_size)) == 0;
+#else
+	return false;
+#endif
+}
+
+void co_curl::file_sink::append(const char * ptr, size_t length) {
+	if (attached && !preallocated) {
+		// headers are already known when first chunk of body arrives
+		preallocated = true;
+
+		if (const auto content_length = attached->get_content_length()) {
+			preallocate(position + *content_length);
+		}
+	}
+
+	while (length != 0u) {
+		const auto common_length = std::min(options.chunk_size - buffer.size(), length);
+		buffer.append(ptr, common_length);
+		position += common_length;
+		ptr += common_length;
+		length -= common_length;
+
+		if (buffer.size() == options.chunk_size) {
+			submit_buffer();
+		}
+	}
+}
+
+bool co_curl::file_sink::pause_writes() {
+	auto lock = std::unique_lock(state->mutex);
+
+	if (state->error != 0) {
+		throw std::system_error(state->error, std::generic_category(), "write into file failed");
+	}
+
+	if (state->outstanding_bytes < options.max_outstanding_bytes) {
+		return false;
+	}
+
+	if (state->handle == nullptr) {
+		// nobody could unpause it
+		state->cv.wait(lock, [&] { return state->outstanding_bytes < options.max_outstanding_bytes || state->error != 0; });
+		return false;
+	}
+
+	state->paused = true;
+	return true;
+}
+
+void co_curl::file_sink::seek(size_t offset) {
+	submit_buffer();
+	position = offset;
+}
+
+void co_curl::file_sink::clear() {
+	seek(options.offset);
+}
+
+void co_curl::file_sink::flush() {
+	submit_buffer();
+
+	if (const int error = drain(); error != 0) {
+		throw std::system_error(error, std::generic_category(), "write into file failed");
+	}
+}
+
+void co_curl::file_sink::submit_buffer() {
+	if (buffer.empty()) {
+		return;
+	}
+
+	// memory is limited by pausing the transfer before the data is appended (see pause_writes)
+	const size_t offset = position - buffer.size();
+
+	{
+		auto lock = std::unique_lock(state->mutex);
+
+		if (state->error != 0) {
+			throw std::system_error(state->error, std::generic_category(), "write into file failed");
+		}
+
+		state->outstanding_bytes += buffer.size();
+	}
+
+	auto data = std::exchange(buffer, std::string{});
+	buffer.reserve(options.chunk_size);
+
+	write_behind(pool, state, fd, std::move(data), offset);
+}
+
+int co_curl::file_sink::drain() noexcept {
+	auto lock = std::unique_lock(state->mutex);
+	state->cv.wait(lock, [&] { return state->outstanding_bytes == 0u; });
+	return state->error;
+}
@@ -0,0 +1,83 @@
+#ifndef CO_CURL_FILE_SINK_HPP
+#define CO_CURL_FILE_SINK_HPP
+
+#include "easy.hpp"
+#include "thread-pool.hpp"
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <cstddef>
+
+namespace co_curl {
+
+struct write_behind_state;
+
+struct file_sink_options {
+	// absolute position in the file where first received byte goes
+	size_t offset{0};
+	// cut the file at `offset` when opened (disable when more sinks write into one file)
+	bool truncate{true};
+	// size of a chunk handed over to the thread_pool
+	size_t chunk_size{1024u * 1024u};
+	// when there is more data waiting for the disk, the attached transfer is paused (other transfers continue)
+	// and it's unpaused by its loop once the thread_pool writes enough, sinks without a handle wait instead
+	size_t max_outstanding_bytes{16u * 1024u * 1024u};
+	// runs a function on the loop of the transfer from another thread (default scheduler's loop when empty)
+	std::function<void(std::function<void()>)> post_to_loop{};
+};
+
+// download target writing with pwrite() from a thread_pool, so the curl thread never waits for the disk
+struct file_sink {
+	using value_type = char;
+
+	thread_pool & pool;
+	int fd{-1};
+	file_sink_options options;
+	size_t position;
+	std::string buffer{};
+	std::shared_ptr<write_behind_state> state;
+	easy_handle * attached{nullptr};
+	bool preallocated{false};
+
+	file_sink(thread_pool & p, const std::filesystem::path & path, file_sink_options opts = {});
+	file_sink(const file_sink &) = delete;
+	file_sink(file_sink &&) = delete;
+
+	file_sink & operator=(const file_sink &) = delete;
+	file_sink & operator=(file_sink &&) = delete;
+
+	~file_sink() noexcept;
+
+	// write body of the handle into this sink and preallocate the file from its Content-Length
+	void attach(easy_handle & handle);
+
+	// reserve space on the disk (only a hint, it doesn't fail when the filesystem can't do it)
+	bool preallocate(size_t total_size) noexcept;
+
+	// used by easy_handle::write_into (throws if some previous write failed)
+	void append(const char * ptr, size_t length);
+	bool pause_writes();
+
+	// move where next received byte is written, together with easy_handle::resume
+	void seek(size_t offset);
+
+	// start again from the original offset
+	void clear();
+
+	// absolute position of next byte (usable as an argument for easy_handle::resume)
+	constexpr size_t size() const noexcept {
+		return position;
+	}
+
+	// wait until everything is written on the disk (throws if some write failed)
+	void flush();
+
+	// internals
+	void submit_buffer();
+	int drain() noexcept;
+};
+
+} // namespace co_curl
+
+#endif
@@ -0,0 +1,51 @@
+#include "file_source.hpp"
+#include <algorithm>
+#include <curl/curl.h>
+
+static size_t file_source_read(char * buffer, size_t size, size_t nitems, void * udata) {
+	auto & source = *static_cast<co_curl::file_source *>(udata);
+	return source.read(std::span<char>(buffer, size * nitems));
+}
+
+static int file_source_seek(void * udata, curl_off_t offset, int origin) {
+	auto & source = *static_cast<co_curl::file_source *>(udata);
+
+	// curl always seeks from the beginning
+	if (origin != SEEK_SET || offset < 0) {
+		return CURL_SEEKFUNC_CANTSEEK;
+	}
+
+	return source.seek(static_cast<size_t>(offset)) ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+}
+
+co_curl::file_source::file_source(const std::filesystem::path & path): file{path} {
+	file.sequential();
+}
+
+void co_curl::file_source::attach(easy_handle & handle) noexcept {
+	handle.infile_size(file.size());
+	handle.read_function(file_source_read);
+	handle.read_data(this);
+
+	curl_easy_setopt(handle.native_handle, CURLOPT_SEEKFUNCTION, file_source_seek);
+	curl_easy_setopt(handle.native_handle, CURLOPT_SEEKDATA, this);
+}
+
+size_t co_curl::file_source::read(std::span<char> target) noexcept {
+	const auto source = file.span().subspan(position);
+	const auto common_length = std::min(target.size(), source.size());
+
+	std::copy_n(source.begin(), common_length, target.begin());
+
+	position += common_length;
+	return common_length;
+}
+
+bool co_curl::file_source::seek(size_t offset) noexcept {
+	if (offset > file.size()) {
+		return false;
+	}
+
+	position = offset;
+	return true;
+}
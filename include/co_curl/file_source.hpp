@@ -0,0 +1,42 @@
+#ifndef CO_CURL_FILE_SOURCE_HPP
+#define CO_CURL_FILE_SOURCE_HPP
+
+#include "easy.hpp"
+#include "mapped_file.hpp"
+#include <filesystem>
+#include <span>
+#include <cstddef>
+
+namespace co_curl {
+
+// upload source streaming a memory mapped file directly into curl's buffer
+struct file_source {
+	mapped_file file;
+	size_t position{0};
+
+	explicit file_source(const std::filesystem::path & path);
+
+	// curl keeps pointer to it after attach
+	file_source(const file_source &) = delete;
+	file_source(file_source &&) = delete;
+	file_source & operator=(const file_source &) = delete;
+	file_source & operator=(file_source &&) = delete;
+
+	// sets read & seek functions and infile_size (seeking is needed for resumed uploads)
+	void attach(easy_handle & handle) noexcept;
+
+	size_t read(std::span<char> target) noexcept;
+	bool seek(size_t offset) noexcept;
+
+	constexpr size_t size() const noexcept {
+		return file.size();
+	}
+
+	constexpr size_t remaining() const noexcept {
+		return file.size() - position;
+	}
+};
+
+} // namespace co_curl
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef CO_CURL_HEDGED_FETCH_HPP
+#define CO_CURL_HEDGED_FETCH_HPP
+
+#include "fetch.hpp"
+#include "histogram.hpp"
+#include "select.hpp"
+#include <algorithm>
+#include <exception>
+#include <optional>
+#include <string>
+#include <chrono>
+
+namespace co_curl {
+
+// when to start a backup transfer, one object is shared by all requests to the same service
+struct hedge_policy {
+	// backup is started after this quantile of observed latencies
+	double percentile{0.95};
+
+	// used until there is enough samples
+	std::chrono::milliseconds initial_delay{100};
+	std::uint64_t min_samples{20};
+
+	std::chrono::milliseconds min_delay{5};
+	std::chrono::milliseconds max_delay{std::chrono::seconds{2}};
+
+	// at most this fraction of requests can start a backup (so a slow service doesn't get twice the load)
+	double max_hedge_ratio{0.1};
+
+	latency_histogram latencies{};
+
+	size_t requests{0};
+	size_t hedges{0};
+	size_t backup_wins{0};
+
+	auto delay() const noexcept -> std::chrono::milliseconds {
+		if (latencies.count() < min_samples) {
+			return initial_delay;
+		}
+
+		const auto p = std::chrono::ceil<std::chrono::milliseconds>(latencies.percentile(percentile).value_or(initial_delay));
+		return std::clamp(p, min_delay, max_delay);
+	}
+
+	bool may_hedge() const noexcept {
+		return static_cast<double>(hedges) < max_hedge_ratio * static_cast<double>(requests);
+	}
+};
+
+template <typename Container> struct hedge_outcome {
+	std::optional<Container> value{};
+	std::exception_ptr error{};
+};
+
+// one transfer of a hedged request, failures are reported as a value so the other transfer can still win
+template <typename Container, typename Scheduler = default_scheduler> auto hedge_attempt(std::string url, int attempts, latency_histogram & latencies) -> co_curl::promise<hedge_outcome<Container>, Scheduler> {
+	auto & scheduler = get_scheduler<Scheduler>();
+	const auto started = scheduler.now();
+
+	try {
+		auto output = co_await fetch<Container, Scheduler>(url, attempts);
+		latencies.record(scheduler.now() - started);
+		co_return hedge_outcome<Container>{.value = std::move(output)};
+	} catch (...) {
+		co_return hedge_outcome<Container>{.error = std::current_exception()};
+	}
+}
+
+// starts the transfer and if it's not finished within `policy.delay()` starts another one (to `backup_url` if provided),
+// first successful one is returned and the other one is cancelled
+template <typename Container = std::string, typename Scheduler = default_scheduler> auto hedged_fetch(std::string url, hedge_policy & policy, std::string backup_url = {}, int attempts = 5) -> co_curl::promise<Container, Scheduler> {
+	++policy.requests;
+
+	auto & scheduler = get_scheduler<Scheduler>();
+	const auto started = scheduler.now();
+	auto primary = hedge_attempt<Container, Scheduler>(url, attempts, policy.latencies);
+
+	if (!co_await wait_any_until(started + policy.delay(), primary) && policy.may_hedge()) {
+		++policy.hedges;
+
+		auto backup = hedge_attempt<Container, Scheduler>(backup_url.empty() ? url : backup_url, attempts, policy.latencies);
+
+		co_await wait_any(primary, backup);
+
+		const bool primary_first = primary.handle.done();
+		auto & first = primary_first ? primary : backup;
+		auto & second = primary_first ? backup : primary;
+
+		bool from_backup = !primary_first;
+		auto outcome = co_await std::move(first);
+
+		if (!outcome.value) {
+			outcome = co_await std::move(second);
+			from_backup = !from_backup;
+		} else if (from_backup && !primary.handle.done()) {
+			// primary is cancelled, but its latency is at least this long (otherwise the histogram would only see winners)
+			policy.latencies.record(scheduler.now() - started);
+		}
+
+		if (!outcome.value) {
+			std::rethrow_exception(outcome.error);
+		}
+
+		if (from_backup) {
+			++policy.backup_wins;
+		}
+
+		co_return std::move(*outcome.value);
+	}
+
+	auto outcome = co_await std::move(primary);
+
+	if (!outcome.value) {
+		std::rethrow_exception(outcome.error);
+	}
+
+	co_return std::move(*outcome.value);
+}
+
+} // namespace co_curl
+
+#endif
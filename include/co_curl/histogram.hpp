@@ -0,0 +1,126 @@
+#ifndef CO_CURL_HISTOGRAM_HPP
+#define CO_CURL_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <optional>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace co_curl {
+
+// log-linear histogram of durations in microseconds: values below 16 have their own bucket, every
+// following power of two is split into 8 linear sub-buckets (relative error is at most 12.5 %)
+// recorded by one thread only (relaxed load and store, no locked read-modify-write), other threads can read it
+struct latency_histogram {
+	using duration = std::chrono::microseconds;
+
+	static constexpr unsigned linear_limit = 16u;
+	static constexpr unsigned sub_bucket_bits = 3u;
+	static constexpr unsigned sub_buckets = 1u << sub_bucket_bits;
+	static constexpr unsigned max_exponent = 40u; // ~12 days
+
+	static constexpr size_t bucket_count = linear_limit + (max_exponent - 4u + 1u) * sub_buckets;
+
+	std::array<std::atomic<std::uint64_t>, bucket_count> buckets{};
+	std::atomic<std::uint64_t> total{0};
+	std::atomic<std::uint64_t> sum_us{0};
+
+	static constexpr auto bucket_for(std::uint64_t us) noexcept -> size_t {
+		if (us < linear_limit) {
+			return static_cast<size_t>(us);
+		}
+
+		const unsigned exponent = static_cast<unsigned>(std::bit_width(us)) - 1u;
+
+		if (exponent > max_exponent) {
+			return bucket_count - 1u;
+		}
+
+		const auto sub = static_cast<unsigned>((us >> (exponent - sub_bucket_bits)) & (sub_buckets - 1u));
+
+		return linear_limit + (exponent - 4u) * sub_buckets + sub;
+	}
+
+	// largest value which falls into the bucket
+	static constexpr auto upper_bound_of(size_t bucket) noexcept -> std::uint64_t {
+		if (bucket < linear_limit) {
+			return bucket;
+		}
+
+		const auto exponent = static_cast<unsigned>((bucket - linear_limit) / sub_buckets) + 4u;
+		const auto sub = static_cast<std::uint64_t>((bucket - linear_limit) % sub_buckets);
+
+		return (std::uint64_t{1} << exponent) + ((sub + 1u) << (exponent - sub_bucket_bits)) - 1u;
+	}
+
+	void record(duration value) noexcept {
+		record_value(static_cast<std::uint64_t>(std::max<duration::rep>(value.count(), 0)));
+	}
+
+	// the histogram can be used for other values than durations too (counts, sizes, ...)
+	void record_value(std::uint64_t value) noexcept {
+		add(buckets[bucket_for(value)], 1u);
+		add(total, 1u);
+		add(sum_us, value);
+	}
+
+	static void add(std::atomic<std::uint64_t> & counter, std::uint64_t n) noexcept {
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	template <typename Rep, typename Period> void record(std::chrono::duration<Rep, Period> value) noexcept {
+		record(std::chrono::duration_cast<duration>(value));
+	}
+
+	auto count() const noexcept -> std::uint64_t {
+		return total.load(std::memory_order_relaxed);
+	}
+
+	auto sum() const noexcept -> duration {
+		return duration{static_cast<duration::rep>(sum_us.load(std::memory_order_relaxed))};
+	}
+
+	// upper bound of the bucket containing the `q` quantile (0.0 - 1.0), nothing without samples
+	auto percentile(double q) const noexcept -> std::optional<duration> {
+		const auto n = count();
+
+		if (n == 0u) {
+			return std::nullopt;
+		}
+
+		const auto rank = std::max<std::uint64_t>(1u, static_cast<std::uint64_t>(std::clamp(q, 0.0, 1.0) * static_cast<double>(n) + 0.5));
+		std::uint64_t seen = 0;
+
+		for (size_t i = 0; i != bucket_count; ++i) {
+			seen += buckets[i].load(std::memory_order_relaxed);
+
+			if (seen >= rank) {
+				return duration{static_cast<duration::rep>(upper_bound_of(i))};
+			}
+		}
+
+		// concurrent recording could make `total` ahead of buckets
+		return duration{static_cast<duration::rep>(upper_bound_of(bucket_count - 1u))};
+	}
+
+	void reset() noexcept {
+		for (auto & b: buckets) {
+			b.store(0u, std::memory_order_relaxed);
+		}
+
+		total.store(0u, std::memory_order_relaxed);
+		sum_us.store(0u, std::memory_order_relaxed);
+	}
+};
+
+static_assert(latency_histogram::bucket_for(17u) == 16u && latency_histogram::upper_bound_of(16u) == 17u);
+static_assert(latency_histogram::upper_bound_of(latency_histogram::bucket_for(1000u)) >= 1000u);
+static_assert(latency_histogram::bucket_for(latency_histogram::upper_bound_of(latency_histogram::bucket_for(1000u)) + 1u) == latency_histogram::bucket_for(1000u) + 1u);
+
+} // namespace co_curl
+
+#endif
@@ -0,0 +1,48 @@
+#include "loop_lag.hpp"
+#include <iostream>
+
+auto co_curl::loop_lag_monitor::label_of(const void * coroutine) const noexcept -> std::string_view {
+	if (const auto it = labels.find(coroutine); it != labels.end()) {
+		return it->second;
+	}
+
+	return {};
+}
+
+void co_curl::loop_lag_monitor::returned(scheduler_metrics & metrics) noexcept {
+	if (!current) {
+		return;
+	}
+
+	const auto now = clock::now();
+	const auto duration = std::chrono::duration_cast<std::chrono::microseconds>(now - started);
+
+	// next part of the same slice starts now, unless the scheduler resumes someone else
+	started = now;
+
+	metrics.loop_lag.record(duration);
+
+	if (duration < threshold) {
+		return;
+	}
+
+	metrics.slow_slices.add();
+
+	const auto slice = slow_slice{.coroutine = current, .label = label_of(current), .duration = duration};
+
+	try {
+		if (report) {
+			report(slice);
+		} else {
+			std::clog << "co_curl: coroutine " << slice.coroutine;
+
+			if (!slice.label.empty()) {
+				std::clog << " (" << slice.label << ")";
+			}
+
+			std::clog << " blocked the scheduler for " << static_cast<double>(duration.count()) / 1000.0 << " ms\n";
+		}
+	} catch (...) {
+		// reporting must not break scheduling
+	}
+}
@@ -0,0 +1,88 @@
+#ifndef CO_CURL_LOOP_LAG_HPP
+#define CO_CURL_LOOP_LAG_HPP
+
+#include "metrics.hpp"
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <chrono>
+#include <coroutine>
+
+namespace co_curl {
+
+struct slow_slice {
+	const void * coroutine{nullptr};
+	std::string_view label{}; // empty when the coroutine has none
+	std::chrono::microseconds duration{};
+};
+
+// measures how long coroutines run between being resumed by the scheduler and giving control back to it (nothing else
+// including transfers progresses meanwhile), every slice goes into `scheduler_metrics::loop_lag` and slices over
+// the threshold are reported, consulted by the scheduler only when enabled
+struct loop_lag_monitor {
+	using clock = std::chrono::steady_clock;
+
+	bool enabled{false};
+	std::chrono::microseconds threshold{std::chrono::milliseconds{10}};
+
+	// called with every slow slice, they are written to std::clog without it
+	std::function<void(const slow_slice &)> report{};
+
+	std::unordered_map<const void *, std::string> labels{};
+
+	// internals
+	const void * current{nullptr};
+	clock::time_point started{};
+
+	void label(std::coroutine_handle<> h, std::string name) {
+		labels.insert_or_assign(h.address(), std::move(name));
+	}
+
+	auto label_of(const void * coroutine) const noexcept -> std::string_view;
+
+	// coroutine finished, its frame address can be reused
+	void forget(const void * coroutine) noexcept {
+		if (!labels.empty()) {
+			labels.erase(coroutine);
+		}
+	}
+
+	// scheduler resumes the coroutine
+	void resumed(const void * coroutine) noexcept {
+		current = coroutine;
+		started = clock::now();
+	}
+
+	// control is back in the scheduler (a nested coroutine suspended, the slice continues when nothing else is resumed)
+	void returned(scheduler_metrics & metrics) noexcept;
+};
+
+// gives the current coroutine a name used in reports of slow slices (doesn't suspend)
+struct label_awaiter {
+	std::string name;
+
+	explicit label_awaiter(std::string n) noexcept: name{std::move(n)} { }
+	label_awaiter(const label_awaiter &) = delete;
+	label_awaiter(label_awaiter &&) noexcept = default;
+
+	bool await_ready() const noexcept {
+		return false;
+	}
+
+	template <typename Promise> bool await_suspend(std::coroutine_handle<Promise> h) {
+		h.promise().scheduler.get_loop_lag().label(h, std::move(name));
+		return false;
+	}
+
+	void await_resume() const noexcept { }
+};
+
+inline auto label(std::string name) -> label_awaiter {
+	return label_awaiter{std::move(name)};
+}
+
+} // namespace co_curl
+
+#endif
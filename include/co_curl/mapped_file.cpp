@@ -0,0 +1,53 @@
+#include "mapped_file.hpp"
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+co_curl::mapped_file::mapped_file(const std::filesystem::path & path) {
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), "can't open '" + path.string() + "'");
+	}
+
+	struct stat info { };
+
+	if (::fstat(fd, &info) != 0) {
+		const int error = errno;
+		::close(fd);
+		throw std::system_error(error, std::generic_category(), "can't stat '" + path.string() + "'");
+	}
+
+	length = static_cast<size_t>(info.st_size);
+
+	// empty files can't be mapped
+	if (length != 0u) {
+		void * addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (addr == MAP_FAILED) {
+			const int error = errno;
+			::close(fd);
+			throw std::system_error(error, std::generic_category(), "can't map '" + path.string() + "'");
+		}
+
+		ptr = static_cast<const char *>(addr);
+	}
+
+	// mapping keeps the file alive
+	::close(fd);
+}
+
+co_curl::mapped_file::~mapped_file() noexcept {
+	if (ptr) {
+		::munmap(const_cast<char *>(ptr), length);
+	}
+}
+
+void co_curl::mapped_file::sequential() const noexcept {
+	if (ptr) {
+		::madvise(const_cast<char *>(ptr), length, MADV_SEQUENTIAL);
+	}
+}
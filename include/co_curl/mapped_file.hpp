@@ -0,0 +1,61 @@
+#ifndef CO_CURL_MAPPED_FILE_HPP
+#define CO_CURL_MAPPED_FILE_HPP
+
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <cstddef>
+
+namespace co_curl {
+
+// read-only memory mapped file
+struct mapped_file {
+	const char * ptr{nullptr};
+	size_t length{0};
+
+	constexpr mapped_file() noexcept = default;
+	explicit mapped_file(const std::filesystem::path & path);
+	mapped_file(const mapped_file &) = delete;
+	constexpr mapped_file(mapped_file && other) noexcept: ptr{std::exchange(other.ptr, nullptr)}, length{std::exchange(other.length, 0u)} { }
+
+	mapped_file & operator=(const mapped_file &) = delete;
+	constexpr mapped_file & operator=(mapped_file && other) noexcept {
+		std::swap(ptr, other.ptr);
+		std::swap(length, other.length);
+		return *this;
+	}
+
+	~mapped_file() noexcept;
+
+	// tell the kernel we will read it from the beginning to the end
+	void sequential() const noexcept;
+
+	constexpr const char * data() const noexcept {
+		return ptr;
+	}
+
+	constexpr size_t size() const noexcept {
+		return length;
+	}
+
+	constexpr bool empty() const noexcept {
+		return length == 0u;
+	}
+
+	constexpr auto span() const noexcept -> std::span<const char> {
+		return {ptr, length};
+	}
+
+	constexpr auto view() const noexcept -> std::string_view {
+		return {ptr, length};
+	}
+
+	constexpr operator std::string_view() const noexcept {
+		return view();
+	}
+};
+
+} // namespace co_curl
+
+#endif
@@ -0,0 +1,95 @@
+#include "metrics.hpp"
+#include <array>
+#include <charconv>
+
+static void append_number(std::string & out, double value) {
+	std::array<char, 32> buffer{};
+	const auto r = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+	out.append(buffer.data(), r.ptr);
+}
+
+static void append_number(std::string & out, std::uint64_t value) {
+	std::array<char, 24> buffer{};
+	const auto r = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+	out.append(buffer.data(), r.ptr);
+}
+
+static void append_number(std::string & out, std::int64_t value) {
+	std::array<char, 24> buffer{};
+	const auto r = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+	out.append(buffer.data(), r.ptr);
+}
+
+static void append_header(std::string & out, std::string_view name, std::string_view help, std::string_view type) {
+	out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+	out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+template <typename T> static void append_metric(std::string & out, std::string_view prefix, std::string_view name, std::string_view help, std::string_view type, T value) {
+	const auto full_name = std::string(prefix).append("_").append(name);
+	append_header(out, full_name, help, type);
+	out.append(full_name).append(" ");
+	append_number(out, value);
+	out.append("\n");
+}
+
+void co_curl::render_prometheus_histogram(std::string & out, std::string_view name, std::string_view help, const latency_histogram & h, double scale) {
+	append_header(out, name, help, "histogram");
+
+	std::uint64_t cumulative = 0;
+	size_t bucket = 0;
+
+	// boundaries 2^k - 1 are upper bounds of the last bucket of each power of two
+	for (unsigned k = 1; k <= latency_histogram::max_exponent + 1u; ++k) {
+		const std::uint64_t limit = (std::uint64_t{1} << k) - 1u;
+
+		for (; bucket != latency_histogram::bucket_count && latency_histogram::upper_bound_of(bucket) <= limit; ++bucket) {
+			cumulative += h.buckets[bucket].load(std::memory_order_relaxed);
+		}
+
+		out.append(name).append("_bucket{le=\"");
+		append_number(out, static_cast<double>(limit) / scale);
+		out.append("\"} ");
+		append_number(out, cumulative);
+		out.append("\n");
+	}
+
+	for (; bucket != latency_histogram::bucket_count; ++bucket) {
+		cumulative += h.buckets[bucket].load(std::memory_order_relaxed);
+	}
+
+	// buckets are read one by one, so +Inf and count must not be smaller than any of them
+	out.append(name).append("_bucket{le=\"+Inf\"} ");
+	append_number(out, cumulative);
+	out.append("\n");
+
+	out.append(name).append("_sum ");
+	append_number(out, static_cast<double>(h.sum_us.load(std::memory_order_relaxed)) / scale);
+	out.append("\n");
+
+	out.append(name).append("_count ");
+	append_number(out, cumulative);
+	out.append("\n");
+}
+
+auto co_curl::render_prometheus(const scheduler_metrics & m, std::string_view prefix) -> std::string {
+	std::string out{};
+
+	append_metric(out, prefix, "tasks_started_total", "Coroutines started.", "counter", m.tasks_started.get());
+	append_metric(out, prefix, "tasks_finished_total", "Coroutines finished.", "counter", m.tasks_finished.get());
+	append_metric(out, prefix, "ready_queue_depth", "Coroutines ready to be resumed.", "gauge", m.ready_queue_depth.get());
+	append_metric(out, prefix, "transfers_in_flight", "Transfers running in the multi handle.", "gauge", m.transfers_in_flight.get());
+	append_metric(out, prefix, "transfers_completed_total", "Transfers completed (successfully or not).", "counter", m.transfers_completed.get());
+	append_metric(out, prefix, "poll_wakeups_total", "Returns from waiting in curl_multi_poll.", "counter", m.poll_wakeups.get());
+	append_metric(out, prefix, "poll_blocked_seconds_total", "Time spent blocked in curl_multi_poll.", "counter", static_cast<double>(m.poll_blocked_us.get()) / 1e6);
+
+	const auto name = [&](std::string_view suffix) { return std::string(prefix).append("_").append(suffix); };
+
+	render_prometheus_histogram(out, name("poll_duration_seconds"), "Duration of single waits in curl_multi_poll.", m.poll_duration, 1e6);
+	render_prometheus_histogram(out, name("completions_per_wakeup"), "Transfers completed between two poll wakeups.", m.completions_per_wakeup, 1.0);
+	render_prometheus_histogram(out, name("transfer_duration_seconds"), "Total time of transfers as measured by libcurl.", m.transfer_latency, 1e6);
+	render_prometheus_histogram(out, name("loop_lag_seconds"), "Time coroutines ran without giving control back to the scheduler.", m.loop_lag, 1e6);
+	append_metric(out, prefix, "slow_slices_total", "Coroutine runs longer than the loop lag threshold.", "counter", m.slow_slices.get());
+
+	return out;
+}
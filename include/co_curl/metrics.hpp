@@ -0,0 +1,71 @@
+#ifndef CO_CURL_METRICS_HPP
+#define CO_CURL_METRICS_HPP
+
+#include "histogram.hpp"
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace co_curl {
+
+// updated only by the scheduler's thread, relaxed atomics so other threads can read (and export) them
+struct metric_counter {
+	std::atomic<std::uint64_t> value{0};
+
+	void add(std::uint64_t n = 1u) noexcept {
+		value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	auto get() const noexcept -> std::uint64_t {
+		return value.load(std::memory_order_relaxed);
+	}
+};
+
+struct metric_gauge {
+	std::atomic<std::int64_t> value{0};
+
+	void set(std::int64_t v) noexcept {
+		value.store(v, std::memory_order_relaxed);
+	}
+
+	auto get() const noexcept -> std::int64_t {
+		return value.load(std::memory_order_relaxed);
+	}
+};
+
+struct scheduler_metrics {
+	metric_counter tasks_started{};
+	metric_counter tasks_finished{};
+	metric_gauge ready_queue_depth{};
+	metric_gauge transfers_in_flight{};
+	metric_counter transfers_completed{};
+
+	// each return from multi_handle::poll and time spent blocked in it
+	metric_counter poll_wakeups{};
+	metric_counter poll_blocked_us{};
+	latency_histogram poll_duration{};
+
+	// transfers completed between two poll wakeups
+	latency_histogram completions_per_wakeup{};
+
+	// whole transfers as measured by libcurl
+	latency_histogram transfer_latency{};
+
+	// how long coroutines ran without giving control back to the scheduler (only with loop_lag_monitor enabled)
+	latency_histogram loop_lag{};
+	metric_counter slow_slices{};
+
+	// internals
+	std::uint64_t completions_since_wakeup{0};
+};
+
+// Prometheus text exposition format (version 0.0.4)
+auto render_prometheus(const scheduler_metrics & metrics, std::string_view prefix = "co_curl") -> std::string;
+
+// histogram in Prometheus format with cumulative buckets at every power of two (values are divided by `scale`)
+void render_prometheus_histogram(std::string & out, std::string_view name, std::string_view help, const latency_histogram & h, double scale);
+
+} // namespace co_curl
+
+#endif
@@ -0,0 +1,110 @@
+#include "mirror_set.hpp"
+#include "url.hpp"
+#include <algorithm>
+
+co_curl::mirror_set::mirror_set(std::vector<std::string> bases) {
+	mirrors.reserve(bases.size());
+
+	for (std::string & b: bases) {
+		add(std::move(b));
+	}
+}
+
+auto co_curl::mirror_set::add(std::string base) -> mirror & {
+	auto host = co_curl::url{base.c_str()}.host().value_or(std::string{});
+	return mirrors.emplace_back(mirror{.base = std::move(base), .host = std::move(host)});
+}
+
+auto co_curl::mirror_set::url_for(size_t index, std::string_view path) const -> std::string {
+	const std::string relative{path};
+	return co_curl::url{mirrors[index].base.c_str(), relative.c_str()}.get().value_or(mirrors[index].base + relative);
+}
+
+auto co_curl::mirror_set::weight(size_t index) const noexcept -> double {
+	const mirror & m = mirrors[index];
+
+	const double latency = std::max(m.samples != 0u ? m.latency_ms : static_cast<double>(initial_latency.count()), 1.0);
+	const double success = 1.0 - std::clamp(m.error_rate, 0.0, 1.0);
+
+	// errors are punished more than latency
+	return (success * success) / (latency * (1.0 + m.in_flight));
+}
+
+auto co_curl::mirror_set::pick(const std::vector<bool> & excluded) -> std::optional<size_t> {
+	const auto is_excluded = [&](size_t i) { return i < excluded.size() && excluded[i]; };
+
+	double best = 0.0;
+
+	for (size_t i = 0; i != mirrors.size(); ++i) {
+		if (!is_excluded(i)) {
+			best = std::max(best, weight(i));
+		}
+	}
+
+	std::vector<double> weights(mirrors.size(), 0.0);
+	double total = 0.0;
+	bool any = false;
+
+	for (size_t i = 0; i != mirrors.size(); ++i) {
+		if (is_excluded(i)) {
+			continue;
+		}
+
+		any = true;
+		weights[i] = std::max(weight(i), best * minimal_weight_ratio);
+		total += weights[i];
+	}
+
+	if (!any) {
+		return std::nullopt;
+	}
+
+	// all of them are failing completely, any is as good as the other
+	if (total <= 0.0) {
+		for (size_t i = 0; i != mirrors.size(); ++i) {
+			if (!is_excluded(i)) {
+				return i;
+			}
+		}
+	}
+
+	double point = std::uniform_real_distribution<double>{0.0, total}(random);
+
+	for (size_t i = 0; i != mirrors.size(); ++i) {
+		if (is_excluded(i)) {
+			continue;
+		}
+
+		if (point < weights[i]) {
+			return i;
+		}
+
+		point -= weights[i];
+	}
+
+	// rounding
+	for (size_t i = mirrors.size(); i != 0u; --i) {
+		if (!is_excluded(i - 1u)) {
+			return i - 1u;
+		}
+	}
+
+	return std::nullopt;
+}
+
+void co_curl::mirror_set::record_success(size_t index, std::optional<std::chrono::microseconds> latency) noexcept {
+	mirror & m = mirrors[index];
+
+	m.error_rate *= (1.0 - alpha);
+
+	if (latency) {
+		const double sample = static_cast<double>(latency->count()) / 1000.0;
+		m.latency_ms = (m.samples == 0u) ? sample : alpha * sample + (1.0 - alpha) * m.latency_ms;
+		++m.samples;
+	}
+}
+
+void co_curl::mirror_set::record_failure(size_t index) noexcept {
+	mirror & m = mirrors[index];
+	m.error_rate = alpha + (1.0 - alpha) * m.error_rate;
+}
@@ -0,0 +1,197 @@
+#ifndef CO_CURL_MIRROR_SET_HPP
+#define CO_CURL_MIRROR_SET_HPP
+
+#include "parallel_fetch.hpp"
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+
+namespace co_curl {
+
+// one server with the same content as the others
+struct mirror {
+	std::string base{}; // URL to which paths are resolved (like "https://example.com/pub/")
+	std::string host{};
+
+	// exponentially weighted moving averages (without samples the mirror is assumed to be good)
+	double latency_ms{0.0}; // time to first byte
+	double error_rate{0.0};
+	size_t samples{0};
+
+	unsigned in_flight{0};
+};
+
+// mirrors of one resource tree with selection weighted by observed latency and errors
+struct mirror_set {
+	std::vector<mirror> mirrors{};
+
+	// weight of a new sample in averages
+	double alpha{0.2};
+
+	// latency of a mirror before first response
+	std::chrono::milliseconds initial_latency{100};
+
+	// every mirror keeps at least this fraction of the best weight, so a recovered mirror is noticed
+	double minimal_weight_ratio{0.02};
+
+	std::minstd_rand random{std::random_device{}()};
+
+	mirror_set() = default;
+	explicit mirror_set(std::vector<std::string> bases);
+
+	// keeps `in_flight` of the mirror up to date
+	struct lease {
+		mirror_set * owner{nullptr};
+		size_t index{0};
+
+		lease(mirror_set & o, size_t i) noexcept: owner{&o}, index{i} {
+			++owner->mirrors[index].in_flight;
+		}
+
+		lease(const lease &) = delete;
+		lease(lease && other) noexcept: owner{std::exchange(other.owner, nullptr)}, index{other.index} { }
+		lease & operator=(const lease &) = delete;
+		lease & operator=(lease &&) = delete;
+
+		~lease() noexcept {
+			if (owner) {
+				--owner->mirrors[index].in_flight;
+			}
+		}
+	};
+
+	auto add(std::string base) -> mirror &;
+
+	auto url_for(size_t index, std::string_view path) const -> std::string;
+
+	// prefers fast and reliable mirrors with less transfers in flight
+	auto weight(size_t index) const noexcept -> double;
+
+	// weighted random choice among mirrors not in `excluded`
+	auto pick(const std::vector<bool> & excluded = {}) -> std::optional<size_t>;
+
+	// latency is not known for ranges, only the error rate is updated then
+	void record_success(size_t index, std::optional<std::chrono::microseconds> latency = std::nullopt) noexcept;
+	void record_failure(size_t index) noexcept;
+
+	size_t size() const noexcept {
+		return mirrors.size();
+	}
+};
+
+// downloads `path` from one of the mirrors, failing over to others on errors (each mirror is tried once)
+template <typename Container = std::string> auto fetch(mirror_set & set, std::string path) -> co_curl::promise<Container> {
+	std::vector<bool> tried(set.size(), false);
+	std::string last_error = "no mirror";
+
+	while (const auto index = set.pick(tried)) {
+		tried[*index] = true;
+
+		const auto leased = mirror_set::lease{set, *index};
+		const auto url = set.url_for(*index, path);
+
+		auto handle = co_curl::easy_handle{url};
+		Container output = make_output_container<Container>();
+
+		handle.follow_location();
+		handle.write_into(output);
+		handle.connection_timeout(std::chrono::seconds{2});
+		handle.low_speed_timeout(100, std::chrono::seconds{1});
+
+		const auto r = co_await handle.perform();
+
+		if (r && handle.get_response_code() == co_curl::http_2XX) {
+			set.record_success(*index, handle.get_time_to_first_byte());
+			co_return output;
+		}
+
+		set.record_failure(*index);
+		last_error = r ? "HTTP " + std::to_string(handle.get_response_code()) : std::string{r.c_str()};
+	}
+
+	throw std::runtime_error(std::string{"couldn't download a file from any mirror: "}.append(path) + " (reason: " + last_error + ")");
+}
+
+// download one range from mirrors, when one fails the rest of the range is requested from another one
+template <typename Sink> auto fetch_range(mirror_set & set, std::string path, byte_range range, Sink & sink, size_t base) -> co_curl::promise<void> {
+	std::vector<bool> tried(set.size(), false);
+
+	while (const auto index = set.pick(tried)) {
+		tried[*index] = true;
+
+		const auto leased = mirror_set::lease{set, *index};
+
+		// one attempt per mirror, other mirrors are the retries
+		auto policy = retry_policy{.max_attempts = 0u};
+		bool failed = false;
+
+		try {
+			co_await fetch_range(set.url_for(*index, path), range, sink, base, policy);
+		} catch (const std::runtime_error &) {
+			failed = true;
+		}
+
+		if (!failed) {
+			set.record_success(*index);
+			co_return;
+		}
+
+		set.record_failure(*index);
+	}
+
+	throw std::runtime_error(std::string{"couldn't download a range of file from any mirror: "}.append(path));
+}
+
+// download a resource split into `segments` ranges, each range is requested from a mirror chosen by weight
+template <typename Container = std::string> auto parallel_fetch(mirror_set & set, std::string path, unsigned segments = 4) -> co_curl::promise<Container> {
+	std::optional<size_t> length{};
+
+	// size from a mirror which answers (not answering HEAD is not counted as an error, it can be unsupported)
+	for (std::vector<bool> tried(set.size(), false); const auto index = set.pick(tried);) {
+		tried[*index] = true;
+
+		if ((length = co_await probe_content_length(set.url_for(*index, path)))) {
+			break;
+		}
+	}
+
+	if (!length || segments < 2u || *length < size_t{2} * minimal_segment_size) {
+		co_return co_await fetch<Container>(set, path);
+	}
+
+	const auto ranges = split_into_ranges(*length, std::min(segments, static_cast<unsigned>(*length / minimal_segment_size)));
+
+	Container output{};
+	output.resize(*length);
+
+	static_assert(sizeof(typename Container::value_type) == sizeof(char));
+	const auto whole = std::span<char>(reinterpret_cast<char *>(output.data()), output.size());
+
+	std::vector<span_writer> writers{};
+	writers.reserve(ranges.size());
+
+	std::vector<co_curl::promise<void>> transfers{};
+	transfers.reserve(ranges.size());
+
+	// ranges started later see `in_flight` of earlier ones, so they spread over mirrors
+	for (const byte_range & range: ranges) {
+		auto & writer = writers.emplace_back(span_writer{.target = whole.subspan(range.first, range.size())});
+		transfers.emplace_back(fetch_range(set, path, range, writer, 0u));
+	}
+
+	for (auto & transfer: transfers) {
+		co_await std::move(transfer);
+	}
+
+	co_return output;
+}
+
+} // namespace co_curl
+
+#endif
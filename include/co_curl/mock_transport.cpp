@@ -0,0 +1,283 @@
+#include "mock_transport.hpp"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <cerrno>
+#include <curl/curl.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// one transfer being served, its connections (one per followed redirect) and threads sending big responses
+struct mock_exchange {
+	co_curl::mock_transport & transport;
+	CURL * handle;
+	const co_curl::mock_response * first;
+	bool https;
+	int error{0};
+	std::vector<int> connections{};
+	std::vector<std::thread> writers{};
+};
+
+} // namespace
+
+static auto serialize(const co_curl::mock_response & response) -> std::string {
+	auto output = "HTTP/1.1 " + std::to_string(response.status) + " Mock\r\n";
+
+	for (const auto & [name, value]: response.headers) {
+		// https:// is served as http:// (libcurl would start TLS before asking us)
+		if (value.starts_with("https://") && std::ranges::equal(name, std::string_view{"location"}, [](char a, char b) { return (a | 0x20) == b; })) {
+			output.append(name).append(": http://").append(std::string_view{value}.substr(8u)).append("\r\n");
+			continue;
+		}
+
+		output.append(name).append(": ").append(value).append("\r\n");
+	}
+
+	// every exchange has its own connection
+	output.append("Connection: close\r\n");
+
+	if (response.chunk_size == 0u) {
+		output.append("Content-Length: ").append(std::to_string(response.body.size())).append("\r\n\r\n").append(response.body);
+		return output;
+	}
+
+	output.append("Transfer-Encoding: chunked\r\n\r\n");
+
+	for (size_t offset = 0; offset < response.body.size(); offset += response.chunk_size) {
+		const auto chunk = std::string_view{response.body}.substr(offset, response.chunk_size);
+
+		char size[16];
+		const auto [end, ec] = std::to_chars(size, size + sizeof(size), chunk.size(), 16);
+		output.append(size, end).append("\r\n").append(chunk).append("\r\n");
+	}
+
+	output.append("0\r\n\r\n");
+	return output;
+}
+
+static auto send_some(int fd, std::string_view data) noexcept -> size_t {
+	size_t sent = 0;
+
+	while (sent != data.size()) {
+		const auto r = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+
+		if (r < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			break;
+		}
+
+		sent += static_cast<size_t>(r);
+	}
+
+	return sent;
+}
+
+static void send_response(mock_exchange & ex, int fd, std::string data) {
+	// socket's buffer usually takes the whole response, the rest is sent by a thread while libcurl reads it
+	::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+	const size_t sent = send_some(fd, data);
+
+	if (sent != data.size()) {
+		ex.writers.emplace_back([fd, sent, data = std::move(data)] {
+			::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+			(void)send_some(fd, std::string_view{data}.substr(sent));
+		});
+	}
+}
+
+#if LIBCURL_VERSION_NUM >= 0x075000
+// called by libcurl when it's connected to our socket, before the request is sent
+static int accept_request(void * ptr, char *, char *, int, int) {
+	auto & ex = *static_cast<mock_exchange *>(ptr);
+
+	try {
+		const int fd = ::accept(ex.transport.listener, nullptr, nullptr);
+
+		if (fd < 0) {
+			return CURL_PREREQFUNC_ABORT;
+		}
+
+		ex.connections.push_back(fd);
+
+		const co_curl::mock_response * response = std::exchange(ex.first, nullptr);
+
+		if (response == nullptr) {
+			// followed redirect
+			char * url = nullptr;
+			curl_easy_getinfo(ex.handle, CURLINFO_EFFECTIVE_URL, &url);
+
+			auto original = std::string{url != nullptr ? url : ""};
+
+			if (ex.https && original.starts_with("http://")) {
+				original.insert(4u, "s");
+			}
+
+			response = &ex.transport.take_response(original);
+		}
+
+		if (response->error != 0) {
+			ex.error = response->error;
+			return CURL_PREREQFUNC_ABORT;
+		}
+
+		send_response(ex, fd, serialize(*response));
+		return CURL_PREREQFUNC_OK;
+	} catch (...) {
+		return CURL_PREREQFUNC_ABORT;
+	}
+}
+#endif
+
+static std::atomic<unsigned> mock_transport_instances{0};
+
+co_curl::mock_transport::mock_transport() {
+	const auto name = "co_curl-mock-" + std::to_string(::getpid()) + "-" + std::to_string(mock_transport_instances.fetch_add(1u)) + ".sock";
+	socket_path = (std::filesystem::temp_directory_path() / name).string();
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+
+	if (socket_path.size() >= sizeof(address.sun_path)) {
+		throw std::runtime_error{"mock_transport: path of socket '" + socket_path + "' is too long"};
+	}
+
+	std::ranges::copy(socket_path, address.sun_path);
+
+	listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (listener < 0) {
+		throw std::system_error(errno, std::generic_category(), "mock_transport: can't create socket");
+	}
+
+	::unlink(socket_path.c_str());
+
+	if (::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0) {
+		const int error = errno;
+		::close(listener);
+		throw std::system_error(error, std::generic_category(), "mock_transport: can't listen on '" + socket_path + "'");
+	}
+}
+
+co_curl::mock_transport::~mock_transport() noexcept {
+	::close(listener);
+	::unlink(socket_path.c_str());
+}
+
+void co_curl::mock_transport::respond(std::string url, mock_response response) {
+	script[std::move(url)].responses.push_back(std::move(response));
+}
+
+auto co_curl::mock_transport::take_response(std::string_view url) -> const mock_response & {
+	const auto it = script.find(std::string{url});
+
+	if (it == script.end() || it->second.responses.empty()) {
+		return unknown;
+	}
+
+	script_entry & entry = it->second;
+	return entry.responses[std::min(entry.used++, entry.responses.size() - 1u)];
+}
+
+void co_curl::mock_transport::add_handle(easy_handle & handle) {
+	auto url = std::string{handle.url()};
+	const mock_response & response = take_response(url);
+
+	requests.push_back(request{.url = url, .started = current});
+	pending.emplace(std::pair{current + response.latency, sequence++}, pending_transfer{.handle = handle.native_handle, .response = &response, .url = std::move(url)});
+}
+
+bool co_curl::mock_transport::remove_handle(easy_handle & handle) noexcept {
+	return remove_handle(handle.native_handle);
+}
+
+bool co_curl::mock_transport::remove_handle(CURL * handle) noexcept {
+	const auto removed = std::erase_if(pending, [handle](const auto & item) { return item.second.handle == handle; });
+	return removed + std::erase_if(done, [handle](const multi_handle::finished & f) { return f.handle == handle; }) != 0u;
+}
+
+auto co_curl::mock_transport::sync_perform() -> std::optional<unsigned> {
+	while (!pending.empty() && pending.begin()->first.first <= current) {
+		const pending_transfer transfer = std::move(pending.begin()->second);
+		pending.erase(pending.begin());
+		done.push_back(multi_handle::finished{.handle = transfer.handle, .code = exchange(transfer)});
+	}
+
+	return static_cast<unsigned>(pending.size());
+}
+
+auto co_curl::mock_transport::get_finished() -> std::optional<multi_handle::finished> {
+	if (done.empty()) {
+		return std::nullopt;
+	}
+
+	const auto f = done.front();
+	done.pop_front();
+	return f;
+}
+
+bool co_curl::mock_transport::poll(std::chrono::milliseconds timeout) noexcept {
+	auto next = current + timeout;
+
+	if (!pending.empty()) {
+		next = std::min(next, pending.begin()->first.first);
+	}
+
+	current = std::max(current, next);
+	return true;
+}
+
+auto co_curl::mock_transport::exchange(const pending_transfer & transfer) -> int {
+	if (transfer.response->error != 0 || !exchanges) {
+		return transfer.response->error;
+	}
+
+#if LIBCURL_VERSION_NUM >= 0x075000
+	const std::string & original = transfer.url;
+
+	auto ex = mock_exchange{.transport = *this, .handle = transfer.handle, .first = transfer.response, .https = original.starts_with("https://")};
+
+	if (ex.https) {
+		curl_easy_setopt(transfer.handle, CURLOPT_URL, ("http://" + original.substr(8u)).c_str());
+	}
+
+	curl_easy_setopt(transfer.handle, CURLOPT_UNIX_SOCKET_PATH, socket_path.c_str());
+	curl_easy_setopt(transfer.handle, CURLOPT_PREREQFUNCTION, accept_request);
+	curl_easy_setopt(transfer.handle, CURLOPT_PREREQDATA, &ex);
+
+	const int code = curl_easy_perform(transfer.handle);
+
+	// unblocks writers when libcurl didn't read everything
+	for (const int fd: ex.connections) {
+		::shutdown(fd, SHUT_RDWR);
+	}
+
+	for (std::thread & writer: ex.writers) {
+		writer.join();
+	}
+
+	for (const int fd: ex.connections) {
+		::close(fd);
+	}
+
+	curl_easy_setopt(transfer.handle, CURLOPT_UNIX_SOCKET_PATH, nullptr);
+	curl_easy_setopt(transfer.handle, CURLOPT_PREREQFUNCTION, nullptr);
+	curl_easy_setopt(transfer.handle, CURLOPT_PREREQDATA, nullptr);
+	curl_easy_setopt(transfer.handle, CURLOPT_URL, original.c_str());
+
+	return ex.error != 0 ? ex.error : code;
+#else
+	// needs CURLOPT_PREREQFUNCTION
+	return CURLE_NOT_BUILT_IN;
+#endif
+}
@@ -0,0 +1,145 @@
+#ifndef CO_CURL_MOCK_TRANSPORT_HPP
+#define CO_CURL_MOCK_TRANSPORT_HPP
+
+#include "easy.hpp"
+#include "multi.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+using CURL = void;
+
+namespace co_curl {
+
+// scripted response of a mock transfer
+struct mock_response {
+	unsigned status{200};
+	std::vector<std::pair<std::string, std::string>> headers{};
+	std::string body{};
+
+	// virtual time from start of the transfer to its completion
+	std::chrono::steady_clock::duration latency{};
+
+	// body is sent with chunked encoding in chunks of this size (whole at once with zero)
+	size_t chunk_size{0};
+
+	// libcurl's error code the transfer fails with (without any response)
+	int error{0};
+};
+
+// transport of basic_scheduler completing transfers from a script on a virtual clock, without network:
+// transfer completes when the virtual clock reaches its start + latency (ties in order of start), then the response
+// is exchanged with the easy handle by libcurl itself over a local unix socket, so all callbacks, headers and
+// response codes behave as with a real server
+//  - responses of an URL are used in order they were added, the last one repeats
+//  - https:// is served as http:// (redirects to https:// too), redirects are followed without additional latency
+//  - request bodies are ignored
+struct mock_transport {
+	using clock = std::chrono::steady_clock;
+
+	struct script_entry {
+		std::deque<mock_response> responses{};
+		size_t used{0};
+	};
+
+	struct request {
+		std::string url{};
+		clock::time_point started{};
+	};
+
+	struct pending_transfer {
+		CURL * handle{nullptr};
+		const mock_response * response{nullptr};
+		std::string url{}; // as requested (effective URL of the handle can be a redirect from its previous transfer)
+	};
+
+	std::unordered_map<std::string, script_entry> script{};
+
+	// response for URLs without script (CURLE_COULDNT_RESOLVE_HOST)
+	mock_response unknown{.error = 6};
+
+	// without exchanges transfers complete only with their scripted error (for measuring scheduling alone)
+	bool exchanges{true};
+
+	// log of started transfers
+	std::vector<request> requests{};
+
+	// constructors
+	mock_transport();
+	mock_transport(const mock_transport &) = delete;
+	mock_transport(mock_transport &&) = delete;
+
+	// destructor
+	~mock_transport() noexcept;
+
+	// assignments
+	mock_transport & operator=(const mock_transport &) = delete;
+	mock_transport & operator=(mock_transport &&) = delete;
+
+	// scripting
+	void respond(std::string url, mock_response response);
+	auto take_response(std::string_view url) -> const mock_response &;
+
+	// virtual clock (starts at real time of construction)
+	auto now() const noexcept -> clock::time_point {
+		return current;
+	}
+
+	void sleep_until(clock::time_point deadline) noexcept {
+		current = std::max(current, deadline);
+	}
+
+	void advance(clock::duration d) noexcept {
+		current += d;
+	}
+
+	// API used by scheduler
+	void add_handle(easy_handle & handle);
+	bool remove_handle(easy_handle & handle) noexcept;
+	bool remove_handle(CURL * handle) noexcept;
+
+	auto sync_perform() -> std::optional<unsigned>;
+	auto get_finished() -> std::optional<multi_handle::finished>;
+
+	// moves virtual clock to the next completion (but at most by `timeout`)
+	bool poll(std::chrono::milliseconds timeout = std::chrono::milliseconds{100}) noexcept;
+
+	bool wakeup() noexcept {
+		return true;
+	}
+
+	void max_total_connections(unsigned) noexcept { }
+
+	// internals
+	clock::time_point current{clock::now()};
+	std::uint64_t sequence{0};
+
+	// ordered by completion time and start
+	std::map<std::pair<clock::time_point, std::uint64_t>, pending_transfer> pending{};
+	std::deque<multi_handle::finished> done{};
+
+	std::string socket_path{};
+	int listener{-1};
+
+	// exchange response with the easy handle, returns libcurl's code
+	auto exchange(const pending_transfer & transfer) -> int;
+};
+
+using mock_scheduler = basic_scheduler<mock_transport>;
+
+inline auto get_mock_transport() -> mock_transport & {
+	return get_scheduler<mock_scheduler>().get_curl();
+}
+
+} // namespace co_curl
+
+#endif
@@ -55,6 +55,15 @@ bool co_curl::multi_handle::poll(std::chrono::milliseconds timeout) noexcept {
 #endif
 }
 
+bool co_curl::multi_handle::wakeup() noexcept {
+#if LIBCURL_VERSION_NUM >= 0x074400
+	return CURLM_OK == curl_multi_wakeup(native_handle);
+#else
+	// poll will return after its timeout
+	return false;
+#endif
+}
+
 auto co_curl::multi_handle::info_read(unsigned & msg_remaining) noexcept -> std::optional<message> {
 	int msg_count{0};
 	CURLMsg * msg = curl_multi_info_read(native_handle, &msg_count);
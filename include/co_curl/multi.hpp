@@ -49,6 +49,9 @@ struct multi_handle {
 
 	bool poll(std::chrono::milliseconds timeout = std::chrono::milliseconds{100}) noexcept;
 
+	// interrupts poll (can be called from any thread)
+	bool wakeup() noexcept;
+
 	// API used by scheduler
 	struct finished {
 		CURL * handle;
@@ -76,18 +79,34 @@ template <typename Scheduler> struct perform_later {
 	Scheduler & scheduler;
 	easy_handle & easy;
 	result & result_ref;
+	bool pending{false};
 
 	perform_later(Scheduler & sch, easy_handle & h) noexcept: scheduler{sch}, easy{h}, result_ref{scheduler.waiting.code} { }
+	perform_later(const perform_later &) = delete;
+	perform_later(perform_later && other) noexcept: scheduler{other.scheduler}, easy{other.easy}, result_ref{other.result_ref}, pending{std::exchange(other.pending, false)} { }
+	perform_later & operator=(const perform_later &) = delete;
+	perform_later & operator=(perform_later &&) = delete;
+
+	// coroutine destroyed while the transfer is running
+	~perform_later() noexcept {
+		if constexpr (requires { scheduler.cancel_transfer(easy); }) {
+			if (pending) {
+				scheduler.cancel_transfer(easy);
+			}
+		}
+	}
 
 	constexpr bool await_ready() noexcept {
 		return false;
 	}
 
 	template <typename T> constexpr auto await_suspend(std::coroutine_handle<T> caller) {
+		pending = true;
 		return scheduler.schedule_later(caller, easy);
 	}
 
-	constexpr result await_resume() const noexcept {
+	constexpr result await_resume() noexcept {
+		pending = false;
 		return result_ref;
 	}
 };
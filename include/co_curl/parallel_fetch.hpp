@@ -0,0 +1,251 @@
+#ifndef CO_CURL_PARALLEL_FETCH_HPP
+#define CO_CURL_PARALLEL_FETCH_HPP
+
+#include "fetch.hpp"
+#include "file_sink.hpp"
+#include "retry_policy.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace co_curl {
+
+// inclusive range of bytes as in HTTP's Range header
+struct byte_range {
+	static constexpr size_t unbounded = (std::numeric_limits<size_t>::max)();
+
+	size_t first{0};
+	size_t last{unbounded};
+
+	constexpr bool is_bounded() const noexcept {
+		return last != unbounded;
+	}
+
+	constexpr size_t size() const noexcept {
+		return last - first + 1u;
+	}
+};
+
+// segments smaller than this are not worth another connection
+inline constexpr size_t minimal_segment_size = 256u * 1024u;
+
+inline auto split_into_ranges(size_t total_size, unsigned segments) -> std::vector<byte_range> {
+	std::vector<byte_range> output{};
+
+	if (total_size == 0u || segments == 0u) {
+		return output;
+	}
+
+	output.reserve(segments);
+
+	const size_t segment_size = (total_size + segments - 1u) / segments;
+
+	for (size_t first = 0; first < total_size; first += segment_size) {
+		output.push_back(byte_range{.first = first, .last = std::min(first + segment_size, total_size) - 1u});
+	}
+
+	return output;
+}
+
+// region of a shared buffer, used as a target for easy_handle::write_into
+struct span_writer {
+	using value_type = char;
+
+	std::span<char> target;
+	size_t used{0};
+
+	void append(const char * ptr, size_t length) {
+		if (length > target.size() - used) {
+			throw std::length_error("received more data than requested range");
+		}
+
+		std::copy_n(ptr, length, target.begin() + static_cast<std::ptrdiff_t>(used));
+		used += length;
+	}
+
+	constexpr size_t size() const noexcept {
+		return used;
+	}
+
+	constexpr void seek(size_t position) noexcept {
+		used = std::min(position, target.size());
+	}
+
+	constexpr void clear() noexcept {
+		used = 0;
+	}
+};
+
+// size of the resource from a HEAD request
+inline auto probe_content_length(std::string url) -> co_curl::promise<std::optional<size_t>> {
+	auto handle = co_curl::easy_handle{url};
+
+	handle.no_body();
+	handle.follow_location();
+	handle.connection_timeout(std::chrono::seconds{2});
+
+	if (!co_await handle.perform()) {
+		co_return std::nullopt;
+	}
+
+	if (handle.get_response_code() != co_curl::http_2XX) {
+		co_return std::nullopt;
+	}
+
+	co_return handle.get_content_length();
+}
+
+// download one range into the sink, on failure only the missing part of this range is requested again
+// (`sink.size() - base` is amount of bytes of the range which are already in the sink)
+template <typename Sink> auto fetch_range(std::string url, byte_range range, Sink & sink, size_t base, retry_policy & policy) -> co_curl::promise<void> {
+	auto handle = co_curl::easy_handle{url};
+
+	handle.follow_location();
+
+	// sinks knowing their transfer can pause it instead of blocking the loop
+	if constexpr (requires { sink.attach(handle); }) {
+		sink.attach(handle);
+	} else {
+		handle.write_into(sink);
+	}
+
+	handle.connection_timeout(std::chrono::seconds{2});
+	handle.low_speed_timeout(100, std::chrono::seconds{1});
+
+	for (unsigned attempt = 0;; ++attempt) {
+		const size_t done = sink.size() - base;
+		const size_t first = range.first + done;
+		const bool asking_for_range = range.is_bounded() || first != 0u;
+
+		if (!asking_for_range) {
+			handle.disable_range();
+		} else if (range.is_bounded()) {
+			handle.range(first, range.last);
+		} else {
+			handle.range(first);
+		}
+
+		const auto r = co_await handle.perform();
+		const unsigned code = handle.get_response_code();
+
+		// server ignoring Range would give us whole resource again
+		if (asking_for_range && code == 200u) {
+			// nothing of it is part of the range (the caller can continue from `sink.size()` after every throw)
+			sink.seek(base + done);
+			throw std::runtime_error(std::string{"server doesn't support range requests: "}.append(url));
+		}
+
+		if (r && code == co_curl::http_2XX && (!range.is_bounded() || sink.size() - base == range.size())) {
+			policy.record_success();
+			co_return;
+		}
+
+		// body of an error response is not part of the document
+		if (code != co_curl::http_2XX) {
+			sink.seek(base + done);
+		}
+
+		// incomplete range is same as a partial transfer
+		const auto delay = policy.should_retry(handle, (r && code == co_curl::http_2XX) ? result::partial_transfer() : r, attempt);
+
+		if (!delay) {
+			// only what was there before this attempt is known to be right
+			sink.seek(base + done);
+			throw std::runtime_error(std::string{"couldn't download a range of file: "}.append(url) + " (reason: " + r.c_str() + ")");
+		}
+
+		co_await co_curl::sleep_for(*delay);
+	}
+}
+
+// download a resource in `segments` concurrent range requests into memory
+template <typename Container = std::string> auto parallel_fetch(std::string url, unsigned segments = 4, int attempts = 5) -> co_curl::promise<Container> {
+	const std::optional<size_t> length = co_await probe_content_length(url);
+
+	// not known size or too small to be worth it
+	if (!length || segments < 2u || *length < size_t{2} * minimal_segment_size) {
+		co_return co_await fetch<Container>(url, attempts);
+	}
+
+	const auto ranges = split_into_ranges(*length, std::min(segments, static_cast<unsigned>(*length / minimal_segment_size)));
+
+	Container output{};
+	output.resize(*length);
+
+	static_assert(sizeof(typename Container::value_type) == sizeof(char));
+	const auto whole = std::span<char>(reinterpret_cast<char *>(output.data()), output.size());
+
+	std::vector<span_writer> writers{};
+	writers.reserve(ranges.size());
+
+	// shared by all ranges, so the retry budget is common
+	auto policy = retry_policy{.max_attempts = static_cast<unsigned>(std::max(attempts, 0))};
+
+	std::vector<co_curl::promise<void>> transfers{};
+	transfers.reserve(ranges.size());
+
+	for (const byte_range & range: ranges) {
+		auto & writer = writers.emplace_back(span_writer{.target = whole.subspan(range.first, range.size())});
+		transfers.emplace_back(fetch_range(url, range, writer, 0u, policy));
+	}
+
+	for (auto & transfer: transfers) {
+		co_await std::move(transfer);
+	}
+
+	co_return output;
+}
+
+// download a resource in `segments` concurrent range requests, each writing at its offset into the file
+inline auto parallel_fetch(std::string url, thread_pool & pool, std::filesystem::path path, unsigned segments = 4, int attempts = 5) -> co_curl::promise<size_t> {
+	const std::optional<size_t> length = co_await probe_content_length(url);
+
+	auto policy = retry_policy{.max_attempts = static_cast<unsigned>(std::max(attempts, 0))};
+
+	if (!length || segments < 2u || *length < size_t{2} * minimal_segment_size) {
+		auto sink = co_curl::file_sink{pool, path};
+		co_await fetch_range(url, byte_range{}, sink, 0u, policy);
+		sink.flush();
+		co_return sink.size();
+	}
+
+	const auto ranges = split_into_ranges(*length, std::min(segments, static_cast<unsigned>(*length / minimal_segment_size)));
+
+	// file_sink is not movable
+	std::vector<std::unique_ptr<co_curl::file_sink>> sinks{};
+	sinks.reserve(ranges.size());
+
+	std::vector<co_curl::promise<void>> transfers{};
+	transfers.reserve(ranges.size());
+
+	for (const byte_range & range: ranges) {
+		// only first one truncates the file
+		auto & sink = sinks.emplace_back(std::make_unique<co_curl::file_sink>(pool, path, file_sink_options{.offset = range.first, .truncate = sinks.empty()}));
+
+		if (sinks.size() == 1u) {
+			sink->preallocate(*length);
+		}
+
+		transfers.emplace_back(fetch_range(url, range, *sink, range.first, policy));
+	}
+
+	for (auto & transfer: transfers) {
+		co_await std::move(transfer);
+	}
+
+	for (auto & sink: sinks) {
+		sink->flush();
+	}
+
+	co_return *length;
+}
+
+} // namespace co_curl
+
+#endif
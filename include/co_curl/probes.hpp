@@ -0,0 +1,29 @@
+#ifndef CO_CURL_PROBES_HPP
+#define CO_CURL_PROBES_HPP
+
+// static tracepoints (USDT) for perf/bpftrace/systemtap, enabled with cmake option CO_CURL_USDT when <sys/sdt.h> is
+// available, each one is a single nop until a tracer attaches to it, without the option they compile to nothing:
+//   bpftrace -e 'usdt:./app:co_curl:schedule_later { printf("%p %p\n", arg0, arg1); }'
+
+#if defined(CO_CURL_USDT) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define CO_CURL_PROBE1(name, a) DTRACE_PROBE1(co_curl, name, a)
+#define CO_CURL_PROBE2(name, a, b) DTRACE_PROBE2(co_curl, name, a, b)
+#define CO_CURL_PROBE3(name, a, b, c) DTRACE_PROBE3(co_curl, name, a, b, c)
+#else
+#define CO_CURL_PROBE1(name, a) ((void)0)
+#define CO_CURL_PROBE2(name, a, b) ((void)0)
+#define CO_CURL_PROBE3(name, a, b, c) ((void)0)
+#endif
+
+// probes and their arguments:
+//   task_start(coroutine)                          promise_type::initial_suspend
+//   task_finish(coroutine, awaiter)                promise_type::final_suspend
+//   schedule_later(coroutine, easy handle)         coroutine suspended on a transfer
+//   select_next(coroutine, source)                 coroutine chosen to resume (0 awaiter, 1 ready, 2 timer, 3 transfer)
+//   complete_something(running transfers)          after each curl_multi_perform
+//   trigger(easy handle, coroutine, result)        transfer finished
+//   pool_add(coroutine)                            thread_pool::add
+//   pool_get_next(coroutine)                       thread_pool::get_next
+
+#endif
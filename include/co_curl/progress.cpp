@@ -0,0 +1,121 @@
+#include "progress.hpp"
+#include <algorithm>
+#include <type_traits>
+#include <curl/curl.h>
+
+static_assert(std::is_same_v<curl_off_t, std::int64_t>);
+
+static int xferinfo_callback(void * udata, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
+	return static_cast<co_curl::progress_stream *>(udata)->report(dltotal, dlnow, ultotal, ulnow);
+}
+
+auto co_curl::stall_policy::operator()(easy_handle &, const transfer_progress & p) noexcept -> progress_action {
+	const size_t bytes = p.downloaded + p.uploaded;
+	const auto expected = static_cast<double>(min_speed) * std::chrono::duration<double>(window).count();
+
+	if (static_cast<double>(bytes - std::min(bytes, base_bytes)) >= expected) {
+		// enough progress, start a new window
+		base_bytes = bytes;
+		base_elapsed = p.elapsed;
+		return progress_action::proceed;
+	}
+
+	if (p.elapsed - base_elapsed >= window) {
+		return progress_action::abort;
+	}
+
+	return progress_action::proceed;
+}
+
+co_curl::progress_stream::progress_stream(easy_handle & h, std::chrono::milliseconds iv, policy_type p, transfer_bookkeeping & w): interval{iv}, policy{std::move(p)}, handle{h}, owner{w} {
+	owner.woken.reserve(owner.live_streams + 1u);
+	owner.streams.insert_or_assign(handle.native_handle, this);
+	++owner.live_streams;
+
+	curl_easy_setopt(handle.native_handle, CURLOPT_XFERINFOFUNCTION, &xferinfo_callback);
+	curl_easy_setopt(handle.native_handle, CURLOPT_XFERINFODATA, static_cast<void *>(this));
+	curl_easy_setopt(handle.native_handle, CURLOPT_NOPROGRESS, 0L);
+}
+
+co_curl::progress_stream::~progress_stream() noexcept {
+	--owner.live_streams;
+
+	if (const auto it = owner.streams.find(handle.native_handle); it != owner.streams.end() && it->second == this) {
+		owner.streams.erase(it);
+	}
+
+	if (handle.native_handle) {
+		curl_easy_setopt(handle.native_handle, CURLOPT_NOPROGRESS, 1L);
+		curl_easy_setopt(handle.native_handle, CURLOPT_XFERINFOFUNCTION, nullptr);
+		curl_easy_setopt(handle.native_handle, CURLOPT_XFERINFODATA, nullptr);
+	}
+}
+
+auto co_curl::progress_stream::report(std::int64_t dltotal, std::int64_t dlnow, std::int64_t ultotal, std::int64_t ulnow) noexcept -> int {
+	const auto now = clock::now();
+
+	if (!reported) {
+		reported = true;
+		started = now;
+		last_report = now;
+	} else if (now - last_report < interval) {
+		return 0;
+	}
+
+	const double seconds = std::chrono::duration<double>(now - last_report).count();
+	const auto downloaded = static_cast<size_t>(std::max<std::int64_t>(dlnow, 0));
+	const auto uploaded = static_cast<size_t>(std::max<std::int64_t>(ulnow, 0));
+
+	auto current = transfer_progress{
+		.downloaded = downloaded,
+		.download_total = static_cast<size_t>(std::max<std::int64_t>(dltotal, 0)),
+		.uploaded = uploaded,
+		.upload_total = static_cast<size_t>(std::max<std::int64_t>(ultotal, 0)),
+		.elapsed = now - started,
+	};
+
+	if (seconds > 0.0) {
+		current.download_speed = static_cast<double>(downloaded - std::min(downloaded, last_downloaded)) / seconds;
+		current.upload_speed = static_cast<double>(uploaded - std::min(uploaded, last_uploaded)) / seconds;
+	}
+
+	last_report = now;
+	last_downloaded = downloaded;
+	last_uploaded = uploaded;
+
+	try {
+		if (policy && policy(handle, current) == progress_action::abort) {
+			return 1;
+		}
+
+		pending = current;
+
+		wake();
+	} catch (...) {
+		return 1;
+	}
+
+	return 0;
+}
+
+void co_curl::progress_stream::wake() noexcept {
+	if (awaiting && !woken) {
+		owner.wake(awaiting);
+		woken = true;
+	}
+}
+
+void co_curl::progress_stream::close() noexcept {
+	finished = true;
+	wake();
+}
+
+void co_curl::progress_stream::forget_awaiting() noexcept {
+	if (awaiting && woken) {
+		// woken, but destroyed before being resumed
+		owner.forget_woken(awaiting);
+	}
+
+	awaiting = {};
+	woken = false;
+}
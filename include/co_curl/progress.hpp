@@ -0,0 +1,123 @@
+#ifndef CO_CURL_PROGRESS_HPP
+#define CO_CURL_PROGRESS_HPP
+
+#include "easy.hpp"
+#include "scheduler.hpp"
+#include <functional>
+#include <optional>
+#include <utility>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+
+namespace co_curl {
+
+struct transfer_progress {
+	// totals are zero when unknown
+	size_t downloaded{0};
+	size_t download_total{0};
+	size_t uploaded{0};
+	size_t upload_total{0};
+
+	// bytes per second since the previous report
+	double download_speed{0.0};
+	double upload_speed{0.0};
+
+	std::chrono::steady_clock::duration elapsed{};
+};
+
+enum class progress_action { proceed, abort };
+
+// aborts transfers which moved less than `min_speed * window` bytes during the last window
+struct stall_policy {
+	using clock = std::chrono::steady_clock;
+
+	size_t min_speed{1024};
+	std::chrono::milliseconds window{std::chrono::seconds{5}};
+
+	// internals
+	size_t base_bytes{0};
+	clock::duration base_elapsed{};
+
+	auto operator()(easy_handle &, const transfer_progress & p) noexcept -> progress_action;
+};
+
+// reports progress of the next transfer of the handle (CURLOPT_XFERINFOFUNCTION) at most once per interval, a consumer
+// awaits `next()` which gives the latest report (older unconsumed ones are dropped) or nullopt once the transfer is finished
+struct progress_stream {
+	using clock = std::chrono::steady_clock;
+
+	// called with each report, it can abort the transfer (with CURLE_ABORTED_BY_CALLBACK) or reprioritize it
+	// (eg. by moving it into another group of the bandwidth manager)
+	using policy_type = std::function<progress_action(easy_handle &, const transfer_progress &)>;
+
+	std::chrono::milliseconds interval;
+	policy_type policy{};
+
+	// internals
+	easy_handle & handle;
+	transfer_bookkeeping & owner;
+	std::optional<transfer_progress> pending{};
+	std::coroutine_handle<> awaiting{};
+	bool woken{false};
+	bool finished{false};
+	bool reported{false};
+	clock::time_point started{};
+	clock::time_point last_report{};
+	size_t last_downloaded{0};
+	size_t last_uploaded{0};
+
+	// stream must outlive its transfer and consumers
+	explicit progress_stream(easy_handle & h, std::chrono::milliseconds iv = std::chrono::milliseconds{250}, policy_type p = {}, transfer_bookkeeping & w = get_scheduler().waiting);
+	progress_stream(const progress_stream &) = delete;
+	progress_stream & operator=(const progress_stream &) = delete;
+	~progress_stream() noexcept;
+
+	struct awaiter {
+		progress_stream * stream;
+
+		awaiter(progress_stream & s) noexcept: stream{&s} { }
+		awaiter(const awaiter &) = delete;
+		awaiter(awaiter && other) noexcept: stream{std::exchange(other.stream, nullptr)} { }
+		awaiter & operator=(const awaiter &) = delete;
+		awaiter & operator=(awaiter &&) = delete;
+
+		// coroutine destroyed while waiting for a report
+		~awaiter() noexcept {
+			if (stream) {
+				stream->forget_awaiting();
+			}
+		}
+
+		bool await_ready() const noexcept {
+			return stream->pending.has_value() || stream->finished;
+		}
+
+		template <typename Promise> auto await_suspend(std::coroutine_handle<Promise> h) {
+			stream->awaiting = h;
+			return h.promise().scheduler.suspend(h);
+		}
+
+		auto await_resume() noexcept -> std::optional<transfer_progress> {
+			progress_stream * s = std::exchange(stream, nullptr);
+			s->awaiting = {};
+			s->woken = false;
+			return std::exchange(s->pending, std::nullopt);
+		}
+	};
+
+	auto next() noexcept -> awaiter {
+		return awaiter{*this};
+	}
+
+	// used by curl and the scheduler
+	auto report(std::int64_t dltotal, std::int64_t dlnow, std::int64_t ultotal, std::int64_t ulnow) noexcept -> int;
+	void wake() noexcept;
+	void close() noexcept;
+	void forget_awaiting() noexcept;
+};
+
+} // namespace co_curl
+
+#endif
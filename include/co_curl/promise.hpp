@@ -150,14 +150,25 @@ template <typename R, typename Scheduler> struct promise_type: internal::promise
 	// we can provide the scheduler as coroutine argument...
 	promise_type(scheduler_type & sch = co_curl::get_scheduler<scheduler_type>(), auto &&...) noexcept: scheduler{sch} { }
 
+	// destroyed before finishing (eg. cancelled by its owner)
+	~promise_type() noexcept {
+		if constexpr (requires { scheduler.forget_awaiter(self()); }) {
+			scheduler.forget_awaiter(self());
+		}
+	}
+
 	// all my promises are immediate
 	constexpr auto initial_suspend() noexcept {
 		scheduler.start();
+		trace(trace_kind::task_created, self().address());
+		CO_CURL_PROBE1(task_start, self().address());
 		return std::suspend_never();
 	};
 
 	constexpr auto final_suspend() noexcept {
-		scheduler.finish();
+		scheduler.finish(self());
+		trace(trace_kind::task_finished, self().address());
+		CO_CURL_PROBE2(task_finish, self().address(), awaiter.address());
 		return suspend_and_schedule_next(*this);
 	};
 
@@ -180,6 +191,10 @@ template <typename R, typename Scheduler> struct promise_type: internal::promise
 			scheduler.add_additional_awaiter(self(), other);
 		} else {
 			awaiter = other;
+
+			if constexpr (requires { scheduler.note_awaiter(self(), other); }) {
+				scheduler.note_awaiter(self(), other);
+			}
 		}
 	}
 
@@ -188,6 +203,10 @@ template <typename R, typename Scheduler> struct promise_type: internal::promise
 			// nothing
 		} else if (awaiter == other) {
 			awaiter = {};
+
+			if constexpr (requires { scheduler.forget_awaiter(self()); }) {
+				scheduler.forget_awaiter(self());
+			}
 		} else {
 			scheduler.remove_additional_awaiter(self(), other);
 		}
@@ -195,7 +214,7 @@ template <typename R, typename Scheduler> struct promise_type: internal::promise
 
 	auto someone_is_waiting_on_me(std::coroutine_handle<> other) -> std::coroutine_handle<> {
 		add_awaiting(other);
-		return scheduler.suspend();
+		return scheduler.suspend(other);
 	}
 };
 
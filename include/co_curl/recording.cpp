@@ -0,0 +1,344 @@
+#include "recording.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+#include <cstdint>
+#include <curl/curl.h>
+
+static constexpr std::string_view recording_magic = "co_curl-recording";
+static constexpr std::uint64_t recording_version = 1u;
+
+static auto equal_ignoring_case(std::string_view lhs, std::string_view rhs) noexcept -> bool {
+	return std::ranges::equal(lhs, rhs, [](char a, char b) { return (a | 0x20) == (b | 0x20); });
+}
+
+// https:// is replayed as http://, so their default ports are the same
+static auto without_default_port(std::string_view authority) noexcept -> std::string_view {
+	if (authority.ends_with(":80")) {
+		authority.remove_suffix(3u);
+	} else if (authority.ends_with(":443")) {
+		authority.remove_suffix(4u);
+	}
+
+	return authority;
+}
+
+auto co_curl::recorded_request::parse(std::string_view head) -> recorded_request {
+	auto out = recorded_request{};
+
+	const auto line = head.substr(0, head.find("\r\n"));
+	const auto method_end = line.find(' ');
+	const auto target_end = line.rfind(' ');
+
+	out.method = line.substr(0, method_end);
+	auto target = method_end != target_end ? line.substr(method_end + 1u, target_end - method_end - 1u) : std::string_view{};
+
+	// absolute form (through a proxy)
+	if (const auto scheme = target.find("://"); scheme != std::string_view::npos && !target.starts_with('/')) {
+		const auto authority = target.substr(scheme + 3u);
+		const auto path = authority.find('/');
+		out.host = without_default_port(authority.substr(0, path));
+		target = path != std::string_view::npos ? authority.substr(path) : std::string_view{"/"};
+	}
+
+	out.target = target;
+
+	for (auto rest = head.substr(std::min(line.size() + 2u, head.size())); !rest.empty();) {
+		const auto header = rest.substr(0, rest.find("\r\n"));
+		rest.remove_prefix(std::min(header.size() + 2u, rest.size()));
+
+		if (const auto colon = header.find(':'); colon != std::string_view::npos && equal_ignoring_case(header.substr(0, colon), "host")) {
+			auto value = header.substr(colon + 1u);
+			value.remove_prefix(std::min(value.find_first_not_of(' '), value.size()));
+			out.host = without_default_port(value);
+		}
+	}
+
+	return out;
+}
+
+// recording format:
+//   str magic, version, count * transfer
+//   transfer: str url, started, code, count * response
+//   response: str method, str host, str target, str head, head_delay, count * { offset since previous chunk, str data }
+// where numbers are LEB128 (code is zigzag encoded), str is length followed by the bytes, times are in microseconds
+
+struct recording_writer {
+	std::string output{};
+
+	void number(std::uint64_t value) {
+		while (value >= 0x80u) {
+			output.push_back(static_cast<char>((value & 0x7Fu) | 0x80u));
+			value >>= 7u;
+		}
+
+		output.push_back(static_cast<char>(value));
+	}
+
+	void time(std::chrono::microseconds value) {
+		number(static_cast<std::uint64_t>(std::max<std::int64_t>(value.count(), 0)));
+	}
+
+	void string(std::string_view value) {
+		number(value.size());
+		output.append(value);
+	}
+};
+
+struct recording_reader {
+	std::string_view input;
+
+	bool number(std::uint64_t & value) noexcept {
+		value = 0;
+
+		for (unsigned shift = 0; shift < 64u; shift += 7u) {
+			if (input.empty()) {
+				return false;
+			}
+
+			const auto byte = static_cast<unsigned char>(input.front());
+			input.remove_prefix(1u);
+			value |= static_cast<std::uint64_t>(byte & 0x7Fu) << shift;
+
+			if ((byte & 0x80u) == 0u) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool time(std::chrono::microseconds & value) noexcept {
+		std::uint64_t tmp = 0;
+
+		if (!number(tmp)) {
+			return false;
+		}
+
+		value = std::chrono::microseconds{static_cast<std::int64_t>(tmp)};
+		return true;
+	}
+
+	bool string(std::string & value) {
+		std::uint64_t length = 0;
+
+		if (!number(length) || input.size() < length) {
+			return false;
+		}
+
+		value.assign(input.substr(0, static_cast<size_t>(length)));
+		input.remove_prefix(static_cast<size_t>(length));
+		return true;
+	}
+};
+
+void co_curl::recording::save(const std::filesystem::path & path) const {
+	auto writer = recording_writer{};
+
+	writer.string(recording_magic);
+	writer.number(recording_version);
+	writer.number(transfers.size());
+
+	for (const recorded_transfer & t: transfers) {
+		writer.string(t.url);
+		writer.time(t.started);
+		writer.number((static_cast<std::uint64_t>(t.code) << 1u) ^ static_cast<std::uint64_t>(t.code >> 31));
+		writer.number(t.responses.size());
+
+		for (const recorded_response & r: t.responses) {
+			writer.string(r.request.method);
+			writer.string(r.request.host);
+			writer.string(r.request.target);
+			writer.string(r.head);
+			writer.time(r.head_delay);
+			writer.number(r.body.size());
+
+			auto previous = std::chrono::microseconds{0};
+
+			for (const recorded_response::chunk & c: r.body) {
+				writer.time(c.offset - std::exchange(previous, c.offset));
+				writer.string(c.data);
+			}
+		}
+	}
+
+	auto file = std::ofstream{path, std::ios::binary | std::ios::trunc};
+
+	if (!file || !file.write(writer.output.data(), static_cast<std::streamsize>(writer.output.size()))) {
+		throw std::runtime_error{"can't write recording '" + path.string() + "'"};
+	}
+}
+
+auto co_curl::recording::load(const std::filesystem::path & path) -> recording {
+	const auto file = co_curl::mapped_file{path};
+	auto reader = recording_reader{file.view()};
+
+	const auto damaged = [&] {
+		return std::runtime_error{"recording '" + path.string() + "' is damaged"};
+	};
+
+	std::string magic{};
+	std::uint64_t version = 0;
+	std::uint64_t count = 0;
+
+	if (!reader.string(magic) || magic != recording_magic || !reader.number(version)) {
+		throw std::runtime_error{"'" + path.string() + "' isn't a recording"};
+	}
+
+	if (version != recording_version) {
+		throw std::runtime_error{"recording '" + path.string() + "' has unsupported version " + std::to_string(version)};
+	}
+
+	if (!reader.number(count)) {
+		throw damaged();
+	}
+
+	auto out = recording{};
+
+	for (std::uint64_t i = 0; i != count; ++i) {
+		auto & t = out.transfers.emplace_back();
+		std::uint64_t code = 0;
+		std::uint64_t responses = 0;
+
+		if (!reader.string(t.url) || !reader.time(t.started) || !reader.number(code) || !reader.number(responses)) {
+			throw damaged();
+		}
+
+		t.code = static_cast<int>(static_cast<std::int64_t>(code >> 1u) ^ -static_cast<std::int64_t>(code & 1u));
+
+		for (std::uint64_t j = 0; j != responses; ++j) {
+			auto & r = t.responses.emplace_back();
+			std::uint64_t chunks = 0;
+
+			if (!reader.string(r.request.method) || !reader.string(r.request.host) || !reader.string(r.request.target) || !reader.string(r.head) || !reader.time(r.head_delay) || !reader.number(chunks)) {
+				throw damaged();
+			}
+
+			auto offset = std::chrono::microseconds{0};
+
+			for (std::uint64_t k = 0; k != chunks; ++k) {
+				auto & c = r.body.emplace_back();
+
+				if (!reader.time(c.offset) || !reader.string(c.data)) {
+					throw damaged();
+				}
+
+				offset += c.offset;
+				c.offset = offset;
+			}
+		}
+	}
+
+	return out;
+}
+
+static auto since(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) noexcept -> std::chrono::microseconds {
+	return std::chrono::duration_cast<std::chrono::microseconds>(to - from);
+}
+
+static int record_exchange(CURL *, curl_infotype type, char * data, size_t size, void * ptr) {
+	auto & t = *static_cast<co_curl::exchange_recorder::active_transfer *>(ptr);
+	auto & responses = t.transfer.responses;
+
+	const auto now = co_curl::exchange_recorder::clock::now();
+	const auto in = std::string_view{data, size};
+
+	// same as libcurl's own verbose output
+	if (t.verbose && (type == CURLINFO_TEXT || type == CURLINFO_HEADER_IN || type == CURLINFO_HEADER_OUT)) {
+		std::fputs(type == CURLINFO_TEXT ? "* " : (type == CURLINFO_HEADER_IN ? "< " : "> "), stderr);
+		std::fwrite(data, 1u, size, stderr);
+	}
+
+	try {
+		if (type == CURLINFO_HEADER_OUT) {
+			// otherwise it's rest of the previous request
+			if (responses.empty() || !responses.back().head.empty() || !responses.back().body.empty()) {
+				if (!responses.empty()) {
+					t.request = now;
+				}
+
+				responses.push_back(co_curl::recorded_response{.request = co_curl::recorded_request::parse(in)});
+				t.informational = false;
+			}
+		} else if (type == CURLINFO_HEADER_IN && !responses.empty() && responses.back().body.empty()) {
+			auto & r = responses.back();
+
+			// status line
+			if (in.starts_with("HTTP/")) {
+				const auto code = in.find(' ');
+				t.informational = code != std::string_view::npos && in.substr(code + 1u).starts_with('1');
+
+				if (!t.informational) {
+					r.head.clear();
+					r.head_delay = since(t.request, now);
+				}
+			}
+
+			if (!t.informational) {
+				r.head.append(in);
+			}
+		} else if (type == CURLINFO_DATA_IN && !responses.empty()) {
+			responses.back().body.push_back(co_curl::recorded_response::chunk{.offset = since(t.request, now), .data = std::string(in)});
+		}
+	} catch (...) {
+		// recording is incomplete, but the transfer continues
+	}
+
+	return 0;
+}
+
+static void stop_recording(CURL * handle, bool verbose) noexcept {
+	curl_easy_setopt(handle, CURLOPT_DEBUGFUNCTION, nullptr);
+	curl_easy_setopt(handle, CURLOPT_DEBUGDATA, nullptr);
+	curl_easy_setopt(handle, CURLOPT_VERBOSE, static_cast<long>(verbose));
+}
+
+void co_curl::exchange_recorder::start() {
+	output = {};
+	origin = clock::now();
+	enabled = true;
+}
+
+auto co_curl::exchange_recorder::stop() -> recording {
+	enabled = false;
+	return std::exchange(output, {});
+}
+
+void co_curl::exchange_recorder::started(easy_handle & trigger) {
+	CURL * handle = trigger.native_handle;
+
+	const auto now = clock::now();
+	auto transfer = recorded_transfer{.url = std::string(trigger.url()), .started = since(origin, now)};
+
+	auto & t = active.insert_or_assign(handle, active_transfer{.started = now, .request = now, .transfer = std::move(transfer), .verbose = trigger.verbose_enabled}).first->second;
+
+	curl_easy_setopt(handle, CURLOPT_DEBUGFUNCTION, record_exchange);
+	curl_easy_setopt(handle, CURLOPT_DEBUGDATA, &t);
+	curl_easy_setopt(handle, CURLOPT_VERBOSE, 1L);
+}
+
+void co_curl::exchange_recorder::finished(CURL * handle, int code) {
+	const auto it = active.find(handle);
+
+	if (it == active.end()) {
+		return;
+	}
+
+	stop_recording(handle, it->second.verbose);
+	auto node = active.extract(it);
+
+	if (enabled) {
+		node.mapped().transfer.code = code;
+		output.transfers.push_back(std::move(node.mapped().transfer));
+	}
+}
+
+void co_curl::exchange_recorder::cancelled(CURL * handle) noexcept {
+	if (const auto it = active.find(handle); it != active.end()) {
+		stop_recording(handle, it->second.verbose);
+		active.erase(it);
+	}
+}
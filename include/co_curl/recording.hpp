@@ -0,0 +1,102 @@
+#ifndef CO_CURL_RECORDING_HPP
+#define CO_CURL_RECORDING_HPP
+
+#include "easy.hpp"
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <chrono>
+
+namespace co_curl {
+
+// recorded responses are replayed for requests with the same method, host (with non-default port) and target (path with query)
+struct recorded_request {
+	std::string method{};
+	std::string host{};
+	std::string target{};
+
+	// from the first line and headers of a request as it was sent
+	static auto parse(std::string_view head) -> recorded_request;
+
+	auto key() const -> std::string {
+		return method + " " + host + target;
+	}
+};
+
+// one response of a recorded transfer (there are more of them when redirects were followed)
+struct recorded_response {
+	recorded_request request{};
+
+	// status line and headers as received (without informational 1XX responses)
+	std::string head{};
+
+	// body as received (before chunked or content encoding is decoded) in pieces as they arrived
+	struct chunk {
+		std::chrono::microseconds offset{};
+		std::string data{};
+	};
+
+	std::vector<chunk> body{};
+
+	// when were headers received, all times are measured from the request (first one from start of the transfer)
+	std::chrono::microseconds head_delay{};
+};
+
+struct recorded_transfer {
+	std::string url{};
+
+	// since start of recording
+	std::chrono::microseconds started{};
+
+	// libcurl's result
+	int code{0};
+
+	std::vector<recorded_response> responses{};
+};
+
+// compact binary file of recorded transfers (lengths and times are variable length integers)
+struct recording {
+	std::vector<recorded_transfer> transfers{};
+
+	void save(const std::filesystem::path & path) const;
+	static auto load(const std::filesystem::path & path) -> recording;
+};
+
+// captures exchanges of transfers run by the scheduler through CURLOPT_DEBUGFUNCTION (verbose output enabled by
+// easy_handle::verbose() is still printed and the option is restored after the transfer, but a debug function set
+// directly on the native handle is replaced), consulted by the scheduler only when enabled
+struct exchange_recorder {
+	using clock = std::chrono::steady_clock;
+
+	bool enabled{false};
+	recording output{};
+
+	// starts a new recording
+	void start();
+
+	// transfers which are still running aren't part of the recording
+	auto stop() -> recording;
+
+	// API used by scheduler
+	void started(easy_handle & handle);
+	void finished(CURL * handle, int code);
+	void cancelled(CURL * handle) noexcept;
+
+	// internals
+	struct active_transfer {
+		clock::time_point started{};
+		clock::time_point request{};
+		recorded_transfer transfer{};
+		bool informational{false}; // headers of 1XX response are skipped
+		bool verbose{false};       // what libcurl would print is printed too
+	};
+
+	clock::time_point origin{};
+	std::unordered_map<CURL *, active_transfer> active{};
+};
+
+} // namespace co_curl
+
+#endif
@@ -0,0 +1,337 @@
+#include "replay_transport.hpp"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <numeric>
+#include <stdexcept>
+#include <system_error>
+#include <cerrno>
+#include <curl/curl.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static auto equal_ignoring_case(std::string_view lhs, std::string_view rhs) noexcept -> bool {
+	return std::ranges::equal(lhs, rhs, [](char a, char b) { return (a | 0x20) == (b | 0x20); });
+}
+
+// recorded head as HTTP/1.1 response on its own connection (whatever version was recorded)
+static auto replayed_head(std::string_view head) -> std::string {
+	if (head.empty()) {
+		return {};
+	}
+
+	std::string output{};
+
+	for (bool first = true; !head.empty(); first = false) {
+		const auto line = head.substr(0, head.find("\r\n"));
+		head.remove_prefix(std::min(line.size() + 2u, head.size()));
+
+		if (first) {
+			const auto code = line.find(' ');
+			output.append("HTTP/1.1 ").append(code != std::string_view::npos ? line.substr(code + 1u) : std::string_view{"200"}).append("\r\n");
+			continue;
+		}
+
+		if (line.empty()) {
+			break;
+		}
+
+		const auto colon = line.find(':');
+		const auto name = line.substr(0, colon);
+
+		if (equal_ignoring_case(name, "connection") || equal_ignoring_case(name, "keep-alive") || equal_ignoring_case(name, "proxy-connection")) {
+			continue;
+		}
+
+		// https:// is served as http://
+		if (const auto scheme = line.find("https://"); equal_ignoring_case(name, "location") && scheme != std::string_view::npos) {
+			output.append(line.substr(0, scheme + 4u)).append(line.substr(scheme + 5u)).append("\r\n");
+			continue;
+		}
+
+		output.append(line).append("\r\n");
+	}
+
+	output.append("Connection: close\r\n\r\n");
+	return output;
+}
+
+static constexpr std::string_view not_recorded = "HTTP/1.1 404 Not Recorded\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+// head is part zero, body pieces follow
+static auto part_count(const co_curl::replay_transport::connection & c) noexcept -> size_t {
+	return 1u + (c.response ? c.response->body.size() : 0u);
+}
+
+static auto part_data(const co_curl::replay_transport::connection & c) noexcept -> std::string_view {
+	if (c.part == 0u) {
+		return c.head;
+	}
+
+	return c.response->body[c.part - 1u].data;
+}
+
+static auto part_offset(const co_curl::replay_transport::connection & c) noexcept -> std::chrono::microseconds {
+	if (!c.response) {
+		return {};
+	}
+
+	return c.part == 0u ? c.response->head_delay : c.response->body[c.part - 1u].offset;
+}
+
+static void set_nonblocking(int fd) noexcept {
+	::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static std::atomic<unsigned> replay_transport_instances{0};
+
+co_curl::replay_transport::replay_transport() {
+	const auto name = "co_curl-replay-" + std::to_string(::getpid()) + "-" + std::to_string(replay_transport_instances.fetch_add(1u)) + ".sock";
+	socket_path = (std::filesystem::temp_directory_path() / name).string();
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+
+	if (socket_path.size() >= sizeof(address.sun_path)) {
+		throw std::runtime_error{"replay_transport: path of socket '" + socket_path + "' is too long"};
+	}
+
+	std::ranges::copy(socket_path, address.sun_path);
+
+	listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (listener < 0) {
+		throw std::system_error(errno, std::generic_category(), "replay_transport: can't create socket");
+	}
+
+	::unlink(socket_path.c_str());
+
+	if (::bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 || ::listen(listener, SOMAXCONN) != 0 || ::pipe(stop_pipe) != 0) {
+		const int error = errno;
+		::close(listener);
+		throw std::system_error(error, std::generic_category(), "replay_transport: can't listen on '" + socket_path + "'");
+	}
+
+	set_nonblocking(listener);
+
+	thread = std::thread([this] { run(); });
+}
+
+co_curl::replay_transport::~replay_transport() noexcept {
+	[[maybe_unused]] const auto r = ::write(stop_pipe[1], "x", 1);
+	thread.join();
+
+	for (const connection & c: connections) {
+		::close(c.fd);
+	}
+
+	::close(listener);
+	::close(stop_pipe[0]);
+	::close(stop_pipe[1]);
+	::unlink(socket_path.c_str());
+}
+
+void co_curl::replay_transport::load(const recording & r, double s) {
+	auto loaded = std::unordered_map<std::string, script_entry>{};
+
+	// identical requests get responses in order their transfers were started
+	auto order = std::vector<size_t>(r.transfers.size());
+	std::iota(order.begin(), order.end(), size_t{0});
+	std::ranges::stable_sort(order, {}, [&](size_t i) { return r.transfers[i].started; });
+
+	for (const size_t i: order) {
+		for (const recorded_response & response: r.transfers[i].responses) {
+			loaded[response.request.key()].responses.push_back(std::make_shared<const recorded_response>(response));
+		}
+	}
+
+	const auto lock = std::lock_guard{mutex};
+	script = std::move(loaded);
+	speed = s;
+}
+
+void co_curl::replay_transport::add_handle(easy_handle & handle) {
+	auto url = std::string{handle.url()};
+
+	if (url.starts_with("https://")) {
+		curl_easy_setopt(handle.native_handle, CURLOPT_URL, ("http://" + url.substr(8u)).c_str());
+	}
+
+	curl_easy_setopt(handle.native_handle, CURLOPT_UNIX_SOCKET_PATH, socket_path.c_str());
+	urls.insert_or_assign(handle.native_handle, std::move(url));
+
+	multi.add_handle(handle);
+}
+
+bool co_curl::replay_transport::remove_handle(easy_handle & handle) noexcept {
+	return remove_handle(handle.native_handle);
+}
+
+bool co_curl::replay_transport::remove_handle(CURL * handle) noexcept {
+	const bool removed = multi.remove_handle(handle);
+
+	if (const auto it = urls.find(handle); it != urls.end()) {
+		curl_easy_setopt(handle, CURLOPT_UNIX_SOCKET_PATH, nullptr);
+		curl_easy_setopt(handle, CURLOPT_URL, it->second.c_str());
+		urls.erase(it);
+	}
+
+	return removed;
+}
+
+auto co_curl::replay_transport::due(const connection & c) const -> std::optional<clock::time_point> {
+	if (!c.answered || c.done) {
+		return std::nullopt;
+	}
+
+	if (c.part == part_count(c)) {
+		return c.base;
+	}
+
+	return c.base + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::micro>(part_offset(c)) / c.speed);
+}
+
+void co_curl::replay_transport::run() {
+	std::vector<pollfd> fds{};
+
+	for (;;) {
+		fds.clear();
+		fds.push_back({.fd = stop_pipe[0], .events = POLLIN, .revents = 0});
+		fds.push_back({.fd = listener, .events = POLLIN, .revents = 0});
+
+		const auto now = clock::now();
+		auto timeout = std::optional<std::chrono::milliseconds>{};
+
+		for (const connection & c: connections) {
+			short events = POLLIN;
+
+			if (const auto next = due(c); next && *next <= now) {
+				events |= POLLOUT;
+			} else if (next) {
+				const auto wait = std::chrono::ceil<std::chrono::milliseconds>(*next - now);
+				timeout = timeout ? std::min(*timeout, wait) : wait;
+			}
+
+			fds.push_back({.fd = c.fd, .events = events, .revents = 0});
+		}
+
+		if (::poll(fds.data(), fds.size(), timeout ? static_cast<int>(timeout->count()) : -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			return;
+		}
+
+		if (fds[0].revents != 0) {
+			return;
+		}
+
+		// iterate over connections from previous round only, accepted ones are appended
+		for (size_t i = connections.size(); i != 0; --i) {
+			const size_t index = i - 1u;
+			connection & c = connections[index];
+
+			if ((fds[index + 2u].revents != 0 && !receive(c)) || !send_due(c)) {
+				::close(c.fd);
+				connections.erase(connections.begin() + static_cast<std::ptrdiff_t>(index));
+			}
+		}
+
+		if (fds[1].revents != 0) {
+			accept_all();
+		}
+	}
+}
+
+void co_curl::replay_transport::accept_all() {
+	for (;;) {
+		const int fd = ::accept(listener, nullptr, nullptr);
+
+		if (fd < 0) {
+			return;
+		}
+
+		set_nonblocking(fd);
+		connections.push_back(connection{.fd = fd});
+	}
+}
+
+bool co_curl::replay_transport::receive(connection & c) {
+	char buffer[16 * 1024];
+	const auto r = ::recv(c.fd, buffer, sizeof(buffer), 0);
+
+	if (r == 0) {
+		return false;
+	} else if (r < 0) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+
+	// request bodies are ignored
+	if (!c.answered) {
+		c.input.append(buffer, static_cast<size_t>(r));
+
+		if (c.input.find("\r\n\r\n") != std::string::npos) {
+			answer(c);
+		}
+	}
+
+	return true;
+}
+
+void co_curl::replay_transport::answer(connection & c) {
+	const auto key = recorded_request::parse(c.input).key();
+
+	c.input.clear();
+	c.answered = true;
+	c.base = clock::now();
+
+	{
+		const auto lock = std::lock_guard{mutex};
+		c.speed = speed;
+
+		if (const auto it = script.find(key); it != script.end() && !it->second.responses.empty()) {
+			script_entry & entry = it->second;
+			c.response = entry.responses[entry.used++ % entry.responses.size()];
+		}
+	}
+
+	c.head = c.response ? replayed_head(c.response->head) : std::string{not_recorded};
+}
+
+bool co_curl::replay_transport::send_due(connection & c) {
+	const auto now = clock::now();
+
+	while (const auto next = due(c)) {
+		if (c.part == part_count(c)) {
+			// all is sent, libcurl closes the connection
+			::shutdown(c.fd, SHUT_WR);
+			c.done = true;
+			break;
+		}
+
+		if (*next > now) {
+			break;
+		}
+
+		const auto data = part_data(c);
+
+		while (c.written != data.size()) {
+			const auto r = ::send(c.fd, data.data() + c.written, data.size() - c.written, MSG_NOSIGNAL);
+
+			if (r < 0) {
+				return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+			}
+
+			c.written += static_cast<size_t>(r);
+		}
+
+		++c.part;
+		c.written = 0;
+	}
+
+	return true;
+}
@@ -0,0 +1,126 @@
+#ifndef CO_CURL_REPLAY_TRANSPORT_HPP
+#define CO_CURL_REPLAY_TRANSPORT_HPP
+
+#include "easy.hpp"
+#include "multi.hpp"
+#include "recording.hpp"
+#include "scheduler.hpp"
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <chrono>
+
+using CURL = void;
+
+namespace co_curl {
+
+// transport of basic_scheduler serving recorded responses instead of real servers, in real time: transfers are run by
+// a multi handle connected to an in-process server over a local unix socket, which answers each request with a
+// recorded response of the same request (in recorded order, starting over when all were used) and sends its headers
+// and body pieces at the recorded times since the request divided by `speed`
+//  - https:// is served as http:// (redirects to https:// too), connection setup isn't replayed
+//  - requests which weren't recorded get 404
+//  - a failed transfer is replayed as its connection closing after the recorded data
+struct replay_transport {
+	using clock = std::chrono::steady_clock;
+
+	struct connection {
+		int fd{-1};
+		std::string input{};
+
+		// answer: head and then body pieces of the response, each is sent at its time since `base`
+		std::shared_ptr<const recorded_response> response{};
+		std::string head{};
+		clock::time_point base{};
+		double speed{1.0};
+		size_t part{0};
+		size_t written{0};
+		bool answered{false};
+		bool done{false};
+	};
+
+	struct script_entry {
+		std::vector<std::shared_ptr<const recorded_response>> responses{};
+		size_t used{0};
+	};
+
+	multi_handle multi{};
+
+	// constructors
+	replay_transport();
+	replay_transport(const replay_transport &) = delete;
+	replay_transport(replay_transport &&) = delete;
+
+	// destructor
+	~replay_transport() noexcept;
+
+	// assignments
+	replay_transport & operator=(const replay_transport &) = delete;
+	replay_transport & operator=(replay_transport &&) = delete;
+
+	// thread-safe, replaces what is served to requests arriving later
+	void load(const recording & r, double speed = 1.0);
+
+	// API used by scheduler
+	void add_handle(easy_handle & handle);
+	bool remove_handle(easy_handle & handle) noexcept;
+	bool remove_handle(CURL * handle) noexcept;
+
+	auto sync_perform() -> std::optional<unsigned> {
+		return multi.sync_perform();
+	}
+
+	auto get_finished() -> std::optional<multi_handle::finished> {
+		return multi.get_finished();
+	}
+
+	bool poll(std::chrono::milliseconds timeout = std::chrono::milliseconds{100}) noexcept {
+		return multi.poll(timeout);
+	}
+
+	bool wakeup() noexcept {
+		return multi.wakeup();
+	}
+
+	void max_total_connections(unsigned num = 8) noexcept {
+		multi.max_total_connections(num);
+	}
+
+	// internals
+	std::mutex mutex{};
+	std::unordered_map<std::string, script_entry> script{};
+	double speed{1.0};
+
+	// URLs of running transfers (they are restored when removed)
+	std::unordered_map<CURL *, std::string> urls{};
+
+	std::string socket_path{};
+	int listener{-1};
+	int stop_pipe[2]{-1, -1};
+	std::vector<connection> connections{};
+	std::thread thread{};
+
+	// server
+	void run();
+	void accept_all();
+	void answer(connection & c);
+	auto due(const connection & c) const -> std::optional<clock::time_point>;
+
+	// false when the connection should be closed
+	bool receive(connection & c);
+	bool send_due(connection & c);
+};
+
+using replay_scheduler = basic_scheduler<replay_transport>;
+
+inline auto get_replay_transport() -> replay_transport & {
+	return get_scheduler<replay_scheduler>().get_curl();
+}
+
+} // namespace co_curl
+
+#endif
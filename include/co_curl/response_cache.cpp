@@ -0,0 +1,282 @@
+#include "response_cache.hpp"
+#include "easy.hpp"
+#include "list.hpp"
+#include "url.hpp"
+#include <algorithm>
+#include <charconv>
+#include <ctime>
+#include <curl/curl.h>
+
+static constexpr auto trim(std::string_view in) noexcept -> std::string_view {
+	constexpr std::string_view whitespace = " \t\r\n";
+
+	const auto first = in.find_first_not_of(whitespace);
+
+	if (first == std::string_view::npos) {
+		return {};
+	}
+
+	const auto last = in.find_last_not_of(whitespace);
+	return in.substr(first, last - first + 1u);
+}
+
+static constexpr bool equal_ignoring_case(std::string_view lhs, std::string_view rhs) noexcept {
+	constexpr auto lower = [](char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; };
+	return std::ranges::equal(lhs, rhs, {}, lower, lower);
+}
+
+static auto parse_http_date(std::string_view value) -> std::optional<long long> {
+	const auto t = curl_getdate(std::string(value).c_str(), nullptr);
+
+	if (t < 0) {
+		return std::nullopt;
+	}
+
+	return static_cast<long long>(t);
+}
+
+auto co_curl::cache_control::parse(std::string_view value) noexcept -> cache_control {
+	cache_control output{};
+
+	while (!value.empty()) {
+		const auto comma = value.find(',');
+		const auto directive = trim(value.substr(0, comma));
+		value = (comma == std::string_view::npos) ? std::string_view{} : value.substr(comma + 1u);
+
+		const auto eq = directive.find('=');
+		const auto name = trim(directive.substr(0, eq));
+
+		if (equal_ignoring_case(name, "no-store")) {
+			output.no_store = true;
+		} else if (equal_ignoring_case(name, "no-cache")) {
+			output.no_cache = true;
+		} else if (equal_ignoring_case(name, "max-age") && eq != std::string_view::npos) {
+			auto argument = trim(directive.substr(eq + 1u));
+
+			if (argument.size() >= 2u && argument.front() == '"' && argument.back() == '"') {
+				argument = argument.substr(1u, argument.size() - 2u);
+			}
+
+			long long seconds = 0;
+
+			if (const auto r = std::from_chars(argument.data(), argument.data() + argument.size(), seconds); r.ec == std::errc{}) {
+				output.max_age = std::chrono::seconds{std::max(seconds, 0ll)};
+			}
+		}
+	}
+
+	return output;
+}
+
+void co_curl::cache_headers::operator()(std::string_view line) {
+	// each response in redirect chain starts with status line
+	if (line.starts_with("HTTP/")) {
+		*this = cache_headers{};
+		return;
+	}
+
+	const auto colon = line.find(':');
+
+	if (colon == std::string_view::npos) {
+		return;
+	}
+
+	const auto name = trim(line.substr(0, colon));
+	const auto value = trim(line.substr(colon + 1u));
+
+	if (equal_ignoring_case(name, "ETag")) {
+		etag = value;
+	} else if (equal_ignoring_case(name, "Last-Modified")) {
+		last_modified = value;
+	} else if (equal_ignoring_case(name, "Cache-Control")) {
+		// header can be repeated
+		const auto another = cache_control::parse(value);
+		control.no_store |= another.no_store;
+		control.no_cache |= another.no_cache;
+
+		if (another.max_age) {
+			control.max_age = another.max_age;
+		}
+	} else if (equal_ignoring_case(name, "Date")) {
+		date = parse_http_date(value);
+	} else if (equal_ignoring_case(name, "Expires")) {
+		// invalid value (like "0") means already expired
+		expires = parse_http_date(value).value_or(0);
+	}
+}
+
+auto co_curl::cache_headers::freshness() const noexcept -> std::chrono::seconds {
+	if (control.no_store || control.no_cache) {
+		return std::chrono::seconds{0};
+	}
+
+	if (control.max_age) {
+		return *control.max_age;
+	}
+
+	if (expires) {
+		const auto now = date.value_or(static_cast<long long>(std::time(nullptr)));
+		return std::chrono::seconds{std::max(*expires - now, 0ll)};
+	}
+
+	return std::chrono::seconds{0};
+}
+
+auto co_curl::response_cache::normalize(std::string_view in) -> std::string {
+	auto u = co_curl::url{std::string(in).c_str()};
+	u.remove_fragment();
+
+	if (auto host = u.host()) {
+		std::ranges::transform(*host, host->begin(), [](char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; });
+		u.set_host(host->c_str());
+	}
+
+	return u.get().value_or(std::string(in));
+}
+
+auto co_curl::response_cache::find(const std::string & key) -> entry * {
+	const auto it = entries.find(key);
+
+	if (it == entries.end()) {
+		return nullptr;
+	}
+
+	recently_used.splice(recently_used.begin(), recently_used, it->second.position);
+	return &it->second;
+}
+
+void co_curl::response_cache::store(const std::string & key, std::shared_ptr<const std::string> body, const cache_headers & headers) {
+	erase(key);
+
+	const size_t cost = body->size() + key.size();
+
+	if (cost > max_bytes) {
+		return;
+	}
+
+	evict_until_fits(cost);
+
+	recently_used.push_front(key);
+
+	entries.emplace(key, entry{
+		.body = std::move(body),
+		.etag = headers.etag,
+		.last_modified = headers.last_modified,
+		.fresh_until = clock::now() + headers.freshness(),
+		.position = recently_used.begin(),
+	});
+
+	used_bytes += cost;
+}
+
+void co_curl::response_cache::refresh(const std::string & key, const cache_headers & headers) {
+	auto * e = find(key);
+
+	if (!e) {
+		return;
+	}
+
+	// 304 can carry updated validators
+	if (!headers.etag.empty()) {
+		e->etag = headers.etag;
+	}
+
+	if (!headers.last_modified.empty()) {
+		e->last_modified = headers.last_modified;
+	}
+
+	e->fresh_until = clock::now() + headers.freshness();
+}
+
+void co_curl::response_cache::erase(const std::string & key) {
+	const auto it = entries.find(key);
+
+	if (it == entries.end()) {
+		return;
+	}
+
+	used_bytes -= it->second.cost(key);
+	recently_used.erase(it->second.position);
+	entries.erase(it);
+}
+
+void co_curl::response_cache::clear() noexcept {
+	entries.clear();
+	recently_used.clear();
+	used_bytes = 0;
+}
+
+void co_curl::response_cache::evict_until_fits(size_t needed) {
+	while (!recently_used.empty() && used_bytes + needed > max_bytes) {
+		// copy as erase() destroys the list item
+		const std::string oldest = recently_used.back();
+		erase(oldest);
+		++stats.evictions;
+	}
+}
+
+auto co_curl::fetch(response_cache & cache, std::string url) -> co_curl::promise<std::string> {
+	const auto key = response_cache::normalize(url);
+
+	auto handle = co_curl::easy_handle{url};
+	auto conditional = co_curl::list{};
+
+	// keep the body alive even if the entry is evicted while we are waiting
+	std::shared_ptr<const std::string> stale{};
+
+	if (const auto * e = cache.find(key)) {
+		if (response_cache::clock::now() < e->fresh_until) {
+			++cache.stats.hits;
+			co_return *e->body;
+		}
+
+		stale = e->body;
+
+		if (!e->etag.empty()) {
+			conditional.append("If-None-Match: " + e->etag);
+		}
+
+		if (!e->last_modified.empty()) {
+			conditional.append("If-Modified-Since: " + e->last_modified);
+		}
+
+		handle.http_headers(conditional);
+	}
+
+	std::string output{};
+	cache_headers headers{};
+
+	handle.follow_location();
+	handle.write_into(output);
+	handle.header_callback(headers);
+	handle.connection_timeout(std::chrono::seconds{2});
+
+	if (const auto r = co_await handle.perform(); !r) {
+		throw std::runtime_error(std::string{"couldn't download a file: "}.append(url) + " (reason: " + r.c_str() + ")");
+	}
+
+	const unsigned code = handle.get_response_code();
+
+	if (code == 304u && stale) {
+		++cache.stats.revalidated;
+		cache.refresh(key, headers);
+		co_return *stale;
+	}
+
+	// server can't answer now, old body is better than an error page (entry stays for next revalidation)
+	if (code >= 500u && stale) {
+		++cache.stats.stale_on_error;
+		co_return *stale;
+	}
+
+	++cache.stats.misses;
+
+	if (code == 200u && !headers.control.no_store && (headers.freshness().count() > 0 || headers.has_validators())) {
+		cache.store(key, std::make_shared<const std::string>(output), headers);
+	} else if (stale && (code == 200u || code == 404u || code == 410u)) {
+		// entry is not valid anymore
+		cache.erase(key);
+	}
+
+	co_return output;
+}
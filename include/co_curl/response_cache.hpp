@@ -0,0 +1,98 @@
+#ifndef CO_CURL_RESPONSE_CACHE_HPP
+#define CO_CURL_RESPONSE_CACHE_HPP
+
+#include "promise.hpp"
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <chrono>
+#include <cstddef>
+
+namespace co_curl {
+
+// parsed Cache-Control header (only what a private client cache cares about)
+struct cache_control {
+	std::optional<std::chrono::seconds> max_age{};
+	bool no_store{false};
+	bool no_cache{false};
+
+	static auto parse(std::string_view value) noexcept -> cache_control;
+};
+
+// headers of a response relevant for caching, fed line by line from easy_handle::header_callback
+struct cache_headers {
+	std::string etag{};
+	std::string last_modified{};
+	cache_control control{};
+
+	// seconds since epoch
+	std::optional<long long> date{};
+	std::optional<long long> expires{};
+
+	// with redirects only headers of the last response are kept
+	void operator()(std::string_view line);
+
+	bool has_validators() const noexcept {
+		return !etag.empty() || !last_modified.empty();
+	}
+
+	// how long the response is fresh (zero means revalidate every time)
+	auto freshness() const noexcept -> std::chrono::seconds;
+};
+
+struct response_cache_stats {
+	size_t hits{0};
+	size_t revalidated{0};
+	size_t misses{0};
+	size_t evictions{0};
+	// revalidation got 5xx and stale body was returned instead
+	size_t stale_on_error{0};
+};
+
+// LRU cache of response bodies keyed by normalized URL with a budget for bytes
+struct response_cache {
+	using clock = std::chrono::steady_clock;
+
+	struct entry {
+		std::shared_ptr<const std::string> body;
+		std::string etag{};
+		std::string last_modified{};
+		clock::time_point fresh_until{};
+		std::list<std::string>::iterator position{};
+
+		size_t cost(const std::string & key) const noexcept {
+			return body->size() + key.size();
+		}
+	};
+
+	size_t max_bytes{64u * 1024u * 1024u};
+	size_t used_bytes{0};
+
+	std::unordered_map<std::string, entry> entries{};
+	std::list<std::string> recently_used{}; // front is the most recent
+	response_cache_stats stats{};
+
+	// scheme and host are lowercased, fragment is removed (invalid URLs are kept as they are)
+	static auto normalize(std::string_view url) -> std::string;
+
+	// marks the entry as recently used
+	auto find(const std::string & key) -> entry *;
+
+	void store(const std::string & key, std::shared_ptr<const std::string> body, const cache_headers & headers);
+	void refresh(const std::string & key, const cache_headers & headers);
+	void erase(const std::string & key);
+	void clear() noexcept;
+
+	void evict_until_fits(size_t needed);
+};
+
+// fresh entries are returned without network, stale are revalidated with If-None-Match/If-Modified-Since
+// (and served as they are when the server answers with 5xx)
+auto fetch(response_cache & cache, std::string url) -> co_curl::promise<std::string>;
+
+} // namespace co_curl
+
+#endif
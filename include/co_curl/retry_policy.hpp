@@ -0,0 +1,84 @@
+#ifndef CO_CURL_RETRY_POLICY_HPP
+#define CO_CURL_RETRY_POLICY_HPP
+
+#include "easy.hpp"
+#include <algorithm>
+#include <optional>
+#include <random>
+#include <chrono>
+
+namespace co_curl {
+
+// decides if and when a failed transfer is repeated, one object can be shared by many coroutines
+struct retry_policy {
+	// how many times is one transfer repeated
+	unsigned max_attempts{5};
+
+	// exponential backoff with full jitter: uniform(0, min(max_delay, base_delay * 2^attempt))
+	std::chrono::milliseconds base_delay{100};
+	std::chrono::milliseconds max_delay{std::chrono::seconds{10}};
+
+	// retry budget: every retry costs one token, every success gives back `budget_per_success`
+	// (with 0.1 there can be at most one retry per ten successful transfers in the long run)
+	double budget{10.0};
+	double budget_max{10.0};
+	double budget_per_success{0.1};
+
+	std::minstd_rand random{std::random_device{}()};
+
+	static bool is_retryable_http_code(unsigned http_code) noexcept {
+		return http_code == 429u || http_code == co_curl::http_5XX;
+	}
+
+	static bool is_retryable(result r, unsigned http_code) noexcept {
+		if (!r) {
+			return r.is_timeout() || r.is_partial_transfer() || r.is_connection_error();
+		}
+
+		return is_retryable_http_code(http_code);
+	}
+
+	auto backoff(unsigned attempt) -> std::chrono::milliseconds {
+		const auto limit = std::min(max_delay.count(), base_delay.count() << std::min(attempt, 30u));
+		return std::chrono::milliseconds{std::uniform_int_distribution<std::chrono::milliseconds::rep>{0, limit}(random)};
+	}
+
+	// how long to wait before next attempt (`attempt` counts from zero), nothing if it shouldn't be repeated
+	auto should_retry(result r, unsigned http_code, unsigned attempt, std::optional<std::chrono::seconds> retry_after = std::nullopt) -> std::optional<std::chrono::milliseconds> {
+		if (attempt >= max_attempts || !is_retryable(r, http_code)) {
+			return std::nullopt;
+		}
+
+		// server told us when to come back, but we won't wait longer than we would on our own
+		if (retry_after && *retry_after > max_delay) {
+			return std::nullopt;
+		}
+
+		if (budget < 1.0) {
+			return std::nullopt;
+		}
+
+		budget -= 1.0;
+
+		const auto delay = backoff(attempt);
+
+		if (retry_after) {
+			return std::max<std::chrono::milliseconds>(delay, *retry_after);
+		}
+
+		return delay;
+	}
+
+	auto should_retry(const easy_handle & handle, result r, unsigned attempt) -> std::optional<std::chrono::milliseconds> {
+		const unsigned http_code = handle.get_response_code();
+		return should_retry(r, http_code, attempt, http_code == 429u || http_code == 503u ? handle.get_retry_after() : std::nullopt);
+	}
+
+	void record_success() noexcept {
+		budget = std::min(budget_max, budget + budget_per_success);
+	}
+};
+
+} // namespace co_curl
+
+#endif
@@ -1,4 +1,6 @@
 #include "scheduler.hpp"
+#include "progress.hpp"
+#include "url.hpp"
 #include <curl/curl.h>
 
 static auto get_coroutine_handle(CURL * handle) noexcept -> std::coroutine_handle<void> {
@@ -7,8 +9,160 @@ static auto get_coroutine_handle(CURL * handle) noexcept -> std::coroutine_handl
 	return std::coroutine_handle<void>::from_address(ptr);
 }
 
-auto co_curl::waiting_coroutines_for_curl_finished::trigger(CURL * handle) noexcept -> std::coroutine_handle<void> {
+auto co_curl::transfer_bookkeeping::triggered(CURL * handle) noexcept -> std::coroutine_handle<void> {
 	auto next_coro = get_coroutine_handle(handle);
-	curl.remove_handle(handle);
+
+	if (!introspection.running_since.empty()) {
+		introspection.running_since.erase(handle);
+	}
+
+	trace(trace_kind::transfer_completed, next_coro.address(), handle, code.code);
+	CO_CURL_PROBE3(trigger, handle, next_coro.address(), code.code);
 	return next_coro;
-}
\ No newline at end of file
+}
+
+// only failures which say the host itself is in trouble
+static bool is_host_failure(const co_curl::result r, CURL * handle, const co_curl::circuit_breaker_options & options) noexcept {
+	if (r.is_connection_error() || r.is_timeout() || r.code == CURLE_COULDNT_RESOLVE_HOST) {
+		return true;
+	}
+
+	if (r && options.count_server_errors) {
+		long http_code{0};
+		curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &http_code);
+		return http_code >= 500 && http_code < 600;
+	}
+
+	return false;
+}
+
+auto co_curl::transfer_bookkeeping::admit(easy_handle & trigger, std::coroutine_handle<> coro_handle, clock::time_point now) -> admission {
+	if (!breakers.enabled && !limits.enabled) {
+		return admission::start;
+	}
+
+	auto host = co_curl::url{std::string(trigger.url()).c_str()}.host().value_or(std::string{});
+
+	auto record = transfer_record{};
+
+	if (breakers.enabled) {
+		const auto decision = breakers.admit(host, now);
+
+		if (!decision.allowed) {
+			code = result::circuit_open();
+			return admission::rejected;
+		}
+
+		record.probe = decision.probe;
+	}
+
+	if (limits.enabled) {
+		record.limited = true;
+		record.queued = !limits.try_start(host, queued_transfer{.coroutine = coro_handle, .handle = &trigger});
+	}
+
+	record.host = std::move(host);
+	const bool queued = record.queued;
+	transfers.insert_or_assign(trigger.native_handle, std::move(record));
+
+	return queued ? admission::queued : admission::start;
+}
+
+auto co_curl::transfer_bookkeeping::next_queued(std::string_view host) -> std::optional<queued_transfer> {
+	auto next = limits.next_to_start(host);
+
+	if (next) {
+		if (const auto it = transfers.find(next->handle->native_handle); it != transfers.end()) {
+			it->second.queued = false;
+		}
+	}
+
+	return next;
+}
+
+static void close_stream(std::unordered_map<CURL *, co_curl::progress_stream *> & streams, CURL * handle) noexcept {
+	if (const auto it = streams.find(handle); it != streams.end()) {
+		co_curl::progress_stream * stream = it->second;
+		streams.erase(it);
+		stream->close();
+	}
+}
+
+auto co_curl::transfer_bookkeeping::finished(CURL * trigger, clock::time_point now) -> std::optional<std::string> {
+	curl_off_t total_us{0};
+	curl_easy_getinfo(trigger, CURLINFO_TOTAL_TIME_T, &total_us);
+
+	metrics.transfers_completed.add();
+	metrics.transfer_latency.record(std::chrono::microseconds{total_us});
+	++metrics.completions_since_wakeup;
+
+	bandwidth.finished(trigger);
+	close_stream(streams, trigger);
+
+	if (!recorder.active.empty()) {
+		recorder.finished(trigger, code.code);
+	}
+
+	const auto it = transfers.find(trigger);
+
+	if (it == transfers.end()) {
+		return std::nullopt;
+	}
+
+	transfer_record record = std::move(it->second);
+	transfers.erase(it);
+
+	breakers.record(record.host, record.probe, is_host_failure(code, trigger, breakers.options), now);
+
+	if (record.limited) {
+		long http_code{0};
+		curl_easy_getinfo(trigger, CURLINFO_RESPONSE_CODE, &http_code);
+
+		curl_off_t ttfb{0};
+		const bool has_ttfb = (CURLE_OK == curl_easy_getinfo(trigger, CURLINFO_STARTTRANSFER_TIME_T, &ttfb)) && ttfb > 0;
+
+		limits.finished(record.host, adaptive_concurrency::classify(code, static_cast<unsigned>(http_code)), has_ttfb ? std::optional{std::chrono::microseconds{ttfb}} : std::nullopt, now);
+		return std::move(record.host);
+	}
+
+	return std::nullopt;
+}
+
+auto co_curl::transfer_bookkeeping::cancel(easy_handle & trigger) noexcept -> std::optional<std::string> {
+	bandwidth.finished(trigger.native_handle);
+	close_stream(streams, trigger.native_handle);
+	introspection.running_since.erase(trigger.native_handle);
+	recorder.cancelled(trigger.native_handle);
+
+	const auto it = transfers.find(trigger.native_handle);
+
+	if (it == transfers.end()) {
+		return std::nullopt;
+	}
+
+	transfer_record record = std::move(it->second);
+	transfers.erase(it);
+
+	breakers.abandon(record.host, record.probe);
+
+	if (record.limited) {
+		limits.cancel(record.host, trigger, !record.queued);
+		return std::move(record.host);
+	}
+
+	return std::nullopt;
+}
+
+void co_curl::transfer_bookkeeping::run_remote_calls() {
+	std::vector<std::function<void()>> calls{};
+
+	{
+		const auto lock = std::lock_guard{remote_mutex};
+		calls.swap(remote_calls);
+		has_remote_calls.store(false, std::memory_order_relaxed);
+	}
+
+	for (auto & fn: calls) {
+		fn();
+	}
+}
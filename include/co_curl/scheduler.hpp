@@ -1,13 +1,34 @@
 #ifndef CO_CURL_SCHEDULER_HPP
 #define CO_CURL_SCHEDULER_HPP
 
+#include "adaptive_concurrency.hpp"
+#include "bandwidth.hpp"
+#include "buffer_pool.hpp"
+#include "circuit_breaker.hpp"
 #include "easy.hpp"
+#include "loop_lag.hpp"
+#include "metrics.hpp"
 #include "multi.hpp"
+#include "probes.hpp"
+#include "recording.hpp"
 #include "task_counter.hpp"
+#include "trace.hpp"
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <cassert>
+#include <cstdint>
 #include <chrono>
 #include <coroutine>
 
@@ -15,6 +36,8 @@ using CURL = void;
 
 namespace co_curl {
 
+struct progress_stream;
+
 struct coroutine_handle_queue {
 	std::queue<std::coroutine_handle<>> data{};
 
@@ -33,24 +56,231 @@ struct coroutine_handle_queue {
 	}
 };
 
-struct waiting_coroutines_for_curl_finished {
-	// std::map<CURL *, std::coroutine_handle<>> data{};
-	multi_handle curl{};
+struct sleeping_coroutines {
+	using clock = std::chrono::steady_clock;
+	using container = std::multimap<clock::time_point, std::coroutine_handle<>>;
+	using iterator = container::iterator;
+
+	container data{};
+
+	auto insert(clock::time_point deadline, std::coroutine_handle<> handle) -> iterator {
+		return data.emplace(deadline, handle);
+	}
+
+	void remove(iterator it) noexcept {
+		data.erase(it);
+	}
+
+	auto take_expired(clock::time_point now = clock::now()) -> std::coroutine_handle<> {
+		if (data.empty() || data.begin()->first > now) {
+			return {};
+		}
+
+		const auto next = data.begin()->second;
+		data.erase(data.begin());
+		return next;
+	}
+
+	auto next_deadline() const noexcept -> std::optional<clock::time_point> {
+		if (data.empty()) {
+			return std::nullopt;
+		}
+
+		return data.begin()->first;
+	}
+
+	bool empty() const noexcept {
+		return data.empty();
+	}
+};
+
+// everything about transfers which doesn't depend on how they are run (implemented in scheduler.cpp)
+struct transfer_bookkeeping {
+	using clock = std::chrono::steady_clock;
+
 	result code{};
+	unsigned running{0};
+
+	// what is known about each running transfer (only when some feature needs it)
+	struct transfer_record {
+		std::string host{};
+		std::uint64_t probe{0}; // half-open period of circuit breaker it probes
+		bool limited{false};    // counted by adaptive concurrency
+		bool queued{false};     // waiting for a free slot of its host
+	};
+
+	std::unordered_map<CURL *, transfer_record> transfers{};
+	circuit_breakers breakers{};
+	adaptive_concurrency limits{};
+	bandwidth_manager bandwidth{};
+	exchange_recorder recorder{};
+
+	// progress streams of transfers (closed when their transfer finishes) and their consumers woken by reports
+	std::unordered_map<CURL *, progress_stream *> streams{};
+	std::vector<std::coroutine_handle<>> woken{};
+	size_t live_streams{0}; // each can be in `woken` once, so it has room for all of them (waking can't throw)
+
+	scheduler_metrics metrics{};
+
+	// for snapshots, kept only when enabled (transfers started and awaits begun before that aren't seen)
+	struct introspection_state {
+		bool enabled{false};
+
+		// when were running transfers started
+		std::unordered_map<CURL *, clock::time_point> running_since{};
+
+		// awaited coroutine -> its first awaiter (others are in scheduler's `waiting_for_someone_else`)
+		std::unordered_map<const void *, const void *> awaited_by{};
+	};
+
+	introspection_state introspection{};
+
+	// functions posted from other threads, called by the loop
+	std::mutex remote_mutex{};
+	std::vector<std::function<void()>> remote_calls{};
+	std::atomic<bool> has_remote_calls{false};
+
+	enum class admission { start, queued, rejected };
+
+	// transfer is handed over to the transport (`now` is always from the scheduler's clock)
+	void started(easy_handle & trigger, std::coroutine_handle<> coro_handle, clock::time_point now) {
+		trigger.set_coroutine_handle(coro_handle);
+
+		if (introspection.enabled) {
+			introspection.running_since.insert_or_assign(trigger.native_handle, now);
+		}
+
+		if (bandwidth.enabled) {
+			bandwidth.started(trigger.native_handle);
+		}
+
+		if (recorder.enabled) {
+			recorder.started(trigger);
+		}
+	}
+
+	// coroutine waiting for the finished transfer
+	auto triggered(CURL * trigger) noexcept -> std::coroutine_handle<>;
+
+	// rejected transfer has its `code` set, queued one is started later by finishing transfers of the same host
+	auto admit(easy_handle & trigger, std::coroutine_handle<> coro_handle, clock::time_point now) -> admission;
+
+	// transfer finished with `code`, returns host which has queued transfers to start
+	auto finished(CURL * trigger, clock::time_point now) -> std::optional<std::string>;
+
+	// next queued transfer of the host allowed by its limit
+	auto next_queued(std::string_view host) -> std::optional<queued_transfer>;
+
+	// coroutine waiting for the transfer was destroyed, returns host which has queued transfers to start
+	auto cancel(easy_handle & trigger) noexcept -> std::optional<std::string>;
 
-	waiting_coroutines_for_curl_finished() {
+	void run_remote_calls();
+
+	// there is always room reserved by progress streams
+	void wake(std::coroutine_handle<> handle) noexcept {
+		woken.push_back(handle);
+	}
+
+	void forget_woken(std::coroutine_handle<> handle) noexcept {
+		std::erase(woken, handle);
+	}
+
+	auto take_woken() noexcept -> std::coroutine_handle<> {
+		if (woken.empty()) {
+			return {};
+		}
+
+		const auto next = woken.front();
+		woken.erase(woken.begin());
+		return next;
+	}
+};
+
+// what runs transfers (multi_handle, or mock_transport for deterministic runs without network):
+//   add_handle(easy_handle &), remove_handle(CURL *), sync_perform() -> number of running transfers, get_finished(),
+//   poll(timeout), wakeup() from any thread and max_total_connections(n)
+// optionally its own clock with now() and sleep_until(time_point) which are then used for timers too
+template <typename Transport> struct waiting_for_transfers: transfer_bookkeeping {
+	Transport curl{};
+
+	waiting_for_transfers() {
 		curl.max_total_connections(8);
 	}
 
+	auto now() const noexcept -> clock::time_point {
+		if constexpr (requires { curl.now(); }) {
+			return curl.now();
+		} else {
+			return clock::now();
+		}
+	}
+
+	void sleep_until(clock::time_point deadline) {
+		if constexpr (requires { curl.sleep_until(deadline); }) {
+			curl.sleep_until(deadline);
+		} else {
+			std::this_thread::sleep_until(deadline);
+		}
+	}
+
 	void insert(easy_handle & trigger, std::coroutine_handle<> coro_handle) {
-		trigger.set_coroutine_handle(coro_handle);
+		started(trigger, coro_handle, now());
 		curl.add_handle(trigger);
 	}
 
-	auto trigger(CURL * trigger) noexcept -> std::coroutine_handle<>;
+	auto trigger(CURL * handle) noexcept -> std::coroutine_handle<> {
+		const auto next_coro = triggered(handle);
+		curl.remove_handle(handle);
+		return next_coro;
+	}
+
+	// start queued transfers of the host while its limit allows it
+	void start_queued(std::string_view host) {
+		while (const auto next = next_queued(host)) {
+			insert(*next->handle, next->coroutine);
+		}
+	}
+
+	void finished(CURL * trigger) {
+		if (const auto host = transfer_bookkeeping::finished(trigger, now())) {
+			start_queued(*host);
+		}
+	}
+
+	void cancel(easy_handle & trigger) noexcept {
+		curl.remove_handle(trigger.native_handle);
+
+		if (const auto host = transfer_bookkeeping::cancel(trigger)) {
+			try {
+				start_queued(*host);
+			} catch (...) {
+				// queued transfers will be started by the next finished one
+			}
+		}
+	}
+
+	// thread-safe, the function is called from the loop (soon if it's waiting for transfers)
+	void post(std::function<void()> fn) {
+		{
+			const auto lock = std::lock_guard{remote_mutex};
+			remote_calls.push_back(std::move(fn));
+			has_remote_calls.store(true, std::memory_order_release);
+		}
 
-	auto complete_something(std::chrono::milliseconds timeout = std::chrono::milliseconds{100}) -> std::coroutine_handle<> {
+		(void)curl.wakeup();
+	}
+
+	// waits for a finished transfer (or until the deadline when provided)
+	auto complete_something(std::optional<clock::time_point> deadline = std::nullopt, std::chrono::milliseconds timeout = std::chrono::milliseconds{100}) -> std::coroutine_handle<> {
 		for (;;) {
+			if (has_remote_calls.load(std::memory_order_acquire)) {
+				run_remote_calls();
+			}
+
+			if (const auto w = take_woken()) {
+				return w;
+			}
+
 			const auto r = curl.sync_perform();
 
 			if (!r.has_value()) {
@@ -59,70 +289,219 @@ struct waiting_coroutines_for_curl_finished {
 				break;
 			}
 
+			running = *r;
+			metrics.transfers_in_flight.set(static_cast<std::int64_t>(running));
+			CO_CURL_PROBE1(complete_something, running);
+
+			if (bandwidth.enabled) {
+				bandwidth.tick();
+			}
+
 			if (const auto f = curl.get_finished()) {
 				this->code = {.code = f->code};
+				finished(f->handle);
 				return trigger(f->handle);
 			}
 
+			if (const auto w = take_woken()) {
+				return w;
+			}
+
 			if (*r == 0) {
 				break;
 			}
 
-			(void)curl.poll(timeout);
+			auto wait = timeout;
+
+			if (deadline) {
+				const auto current = now();
+
+				if (current >= *deadline) {
+					break;
+				}
+
+				wait = std::min(wait, std::chrono::ceil<std::chrono::milliseconds>(*deadline - current));
+			}
+
+			const auto poll_start = clock::now();
+			(void)curl.poll(wait);
+			const auto blocked = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - poll_start);
+
+			metrics.poll_wakeups.add();
+			metrics.poll_blocked_us.add(static_cast<std::uint64_t>(blocked.count()));
+			metrics.poll_duration.record(blocked);
+			metrics.completions_per_wakeup.record_value(std::exchange(metrics.completions_since_wakeup, 0u));
 		}
 
 		return {};
 	}
 };
 
+using waiting_coroutines_for_curl_finished = waiting_for_transfers<multi_handle>;
+
 template <typename Scheduler, typename Promise, typename T> concept scheduler_transforms = requires(Scheduler & sch, std::coroutine_handle<Promise> current, T obj) {
 	{ sch.transform(current, obj) };
 };
 
-struct default_scheduler: task_counter {
+template <typename Transport = multi_handle> struct basic_scheduler: task_counter {
 	coroutine_handle_queue ready{};
-	waiting_coroutines_for_curl_finished waiting{};
+	waiting_for_transfers<Transport> waiting{};
+	sleeping_coroutines timers{};
 	std::multimap<std::coroutine_handle<>, std::coroutine_handle<>> waiting_for_someone_else{};
+	buffer_pool buffers{};
+	loop_lag_monitor lag{};
+
+	void start() noexcept {
+		task_counter::start();
+		waiting.metrics.tasks_started.add();
+	}
+
+	void finish(std::coroutine_handle<> h = {}) noexcept {
+		task_counter::finish();
+		waiting.metrics.tasks_finished.add();
+
+		if (lag.enabled && h && lag.current == h.address()) {
+			// its last slice ends here
+			lag.returned(waiting.metrics);
+			lag.current = nullptr;
+		}
+
+		// labels are used by snapshots too
+		if (h) {
+			lag.forget(h.address());
+		}
+	}
 
 	auto schedule_later(std::coroutine_handle<> h, co_curl::easy_handle & curl) -> std::coroutine_handle<> {
-		waiting.insert(curl, h);
+		CO_CURL_PROBE2(schedule_later, h.address(), curl.native_handle);
+
+		const auto admission = waiting.admit(curl, h, now());
+
+		if (admission == transfer_bookkeeping::admission::rejected) {
+			// fail fast, result is already set
+			return h;
+		}
+
+		if (admission == transfer_bookkeeping::admission::start) {
+			waiting.insert(curl, h);
+		}
+
+		trace(trace_kind::task_suspended, h.address());
+		trace(trace_kind::transfer_added, h.address(), curl.native_handle);
+
+		task_counter::blocked();
+		return select_next_coroutine();
+	}
+
+	// suspending coroutine is needed only for tracing
+	auto suspend(std::coroutine_handle<> h = {}) -> std::coroutine_handle<> {
+		if (h) {
+			trace(trace_kind::task_suspended, h.address());
+		}
+
 		task_counter::blocked();
 		return select_next_coroutine();
 	}
 
-	auto suspend() -> std::coroutine_handle<> {
+	auto schedule_at(std::coroutine_handle<> h, sleeping_coroutines::clock::time_point deadline, sleeping_coroutines::iterator & out) -> std::coroutine_handle<> {
+		out = timers.insert(deadline, h);
+		trace(trace_kind::task_suspended, h.address());
 		task_counter::blocked();
 		return select_next_coroutine();
 	}
 
+	// bookkeeping of a coroutine chosen to run (source is where it came from, see probes.hpp)
+	auto resuming(std::coroutine_handle<> h, [[maybe_unused]] int source) noexcept -> std::coroutine_handle<> {
+		task_counter::unblocked();
+		trace(trace_kind::task_resumed, h.address());
+		CO_CURL_PROBE2(select_next, h.address(), source);
+
+		if (lag.enabled) {
+			lag.resumed(h.address());
+		}
+
+		return h;
+	}
+
 	auto select_next_coroutine(std::coroutine_handle<> immediate_awaiter = {}) -> std::coroutine_handle<> {
+		if (lag.enabled) {
+			lag.returned(waiting.metrics);
+		}
+
 		if (immediate_awaiter) {
 			// std::cout << "[immediate awaiter]\n";
-			task_counter::unblocked();
-			return immediate_awaiter;
+			return resuming(immediate_awaiter, 0);
 		} else if (auto next_ready = ready.take_one()) {
 			// std::cout << "[next_ready]\n";
-			task_counter::unblocked();
-			return next_ready;
+			waiting.metrics.ready_queue_depth.set(static_cast<std::int64_t>(ready.data.size()));
+			return resuming(next_ready, 1);
+
+		} else if (auto next_expired = timers.empty() ? std::coroutine_handle<>{} : timers.take_expired(now())) {
+			return resuming(next_expired, 2);
 
 		} else if (task_counter::graph_blocked()) {
 			// std::cout << "[blocked]\n";
-			if (auto next_completed = waiting.complete_something()) {
+			if (auto next_completed = wait_for_transfer_or_timer()) {
 				// std::cout << " [completed]\n";
-				task_counter::unblocked();
-				return next_completed;
+				return resuming(next_completed, 3);
 			}
 		}
 		// std::cout << "------\n";
+		if (lag.enabled) {
+			// time spent waiting above isn't part of the interrupted slice
+			lag.started = loop_lag_monitor::clock::now();
+		}
+
 		return std::noop_coroutine();
 	}
 
+	auto wait_for_transfer_or_timer() -> std::coroutine_handle<> {
+		for (;;) {
+			if (auto expired = timers.take_expired(now())) {
+				return expired;
+			}
+
+			const auto deadline = timers.next_deadline();
+
+			if (auto completed = waiting.complete_something(deadline)) {
+				return completed;
+			}
+
+			if (!deadline) {
+				// nothing to wait for
+				return {};
+			}
+
+			if (waiting.running == 0u) {
+				// only sleeping coroutines are left
+				waiting.sleep_until(*deadline);
+			}
+		}
+	}
+
+	void note_awaiter(std::coroutine_handle<> awaited, std::coroutine_handle<> awaiter) {
+		if (waiting.introspection.enabled) {
+			waiting.introspection.awaited_by.insert_or_assign(awaited.address(), awaiter.address());
+		}
+	}
+
+	// also when the awaited coroutine is destroyed without finishing
+	void forget_awaiter(std::coroutine_handle<> awaited) noexcept {
+		if (!waiting.introspection.awaited_by.empty()) {
+			waiting.introspection.awaited_by.erase(awaited.address());
+		}
+	}
+
 	void wakeup_coroutines_waiting_for(std::coroutine_handle<> awaited) {
+		forget_awaiter(awaited);
+
 		const auto [f, l] = waiting_for_someone_else.equal_range(awaited);
 
 		for (auto it = f; it != l; it = waiting_for_someone_else.erase(it)) {
 			ready.insert(it->second);
 		}
+
+		waiting.metrics.ready_queue_depth.set(static_cast<std::int64_t>(ready.data.size()));
 	}
 
 	void add_additional_awaiter(std::coroutine_handle<> awaited, std::coroutine_handle<> sleeping) {
@@ -141,11 +520,105 @@ struct default_scheduler: task_counter {
 		}
 	}
 
-	auto get_curl() -> multi_handle & {
+	void cancel_transfer(co_curl::easy_handle & curl) noexcept {
+		waiting.cancel(curl);
+	}
+
+	auto get_curl() -> Transport & {
 		return waiting.curl;
 	}
+
+	// time of timers (transport's clock when it has one)
+	auto now() const noexcept -> sleeping_coroutines::clock::time_point {
+		return waiting.now();
+	}
+
+	auto get_circuit_breakers() -> circuit_breakers & {
+		return waiting.breakers;
+	}
+
+	auto get_adaptive_concurrency() -> adaptive_concurrency & {
+		return waiting.limits;
+	}
+
+	auto get_bandwidth() -> bandwidth_manager & {
+		return waiting.bandwidth;
+	}
+
+	auto get_metrics() -> scheduler_metrics & {
+		return waiting.metrics;
+	}
+
+	auto get_recorder() -> exchange_recorder & {
+		return waiting.recorder;
+	}
+
+	auto get_introspection() -> transfer_bookkeeping::introspection_state & {
+		return waiting.introspection;
+	}
+
+	auto get_loop_lag() -> loop_lag_monitor & {
+		return lag;
+	}
 };
 
+using default_scheduler = basic_scheduler<multi_handle>;
+
+// suspends current coroutine until the deadline, other coroutines and transfers are running meanwhile
+struct sleep_awaiter {
+	using clock = sleeping_coroutines::clock;
+
+	// relative sleeps are measured from the moment of suspension by scheduler's clock
+	std::optional<clock::time_point> deadline{};
+	clock::duration delay{};
+	sleeping_coroutines * timers{nullptr};
+	sleeping_coroutines::iterator position{};
+
+	explicit sleep_awaiter(clock::time_point tp) noexcept: deadline{tp} { }
+	explicit sleep_awaiter(clock::duration d) noexcept: delay{d} { }
+	sleep_awaiter(const sleep_awaiter &) = delete;
+	sleep_awaiter(sleep_awaiter && other) noexcept: deadline{other.deadline}, delay{other.delay}, timers{std::exchange(other.timers, nullptr)}, position{other.position} { }
+	sleep_awaiter & operator=(const sleep_awaiter &) = delete;
+	sleep_awaiter & operator=(sleep_awaiter &&) = delete;
+
+	// coroutine destroyed while sleeping
+	~sleep_awaiter() noexcept {
+		if (timers) {
+			timers->remove(position);
+		}
+	}
+
+	bool await_ready() const noexcept {
+		return !deadline && delay <= clock::duration{};
+	}
+
+	template <typename Promise> auto await_suspend(std::coroutine_handle<Promise> h) -> std::coroutine_handle<> {
+		auto & scheduler = h.promise().scheduler;
+		const auto now = scheduler.now();
+		const auto until = deadline.value_or(now + delay);
+
+		if (until <= now) {
+			return h;
+		}
+
+		timers = &scheduler.timers;
+		return scheduler.schedule_at(h, until, position);
+	}
+
+	void await_resume() noexcept {
+		// scheduler already removed us
+		timers = nullptr;
+	}
+};
+
+inline auto sleep_until(sleeping_coroutines::clock::time_point deadline) noexcept -> sleep_awaiter {
+	return sleep_awaiter{deadline};
+}
+
+template <typename Rep, typename Period> auto sleep_for(std::chrono::duration<Rep, Period> duration) noexcept -> sleep_awaiter {
+	return sleep_awaiter{std::chrono::ceil<sleeping_coroutines::clock::duration>(duration)};
+}
+
 template <typename T = default_scheduler> auto get_scheduler() -> T & {
 	static T global_scheduler{};
 	return global_scheduler;
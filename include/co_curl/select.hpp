@@ -2,6 +2,8 @@
 #define CO_CURL_SELECT_HPP
 
 #include "all.hpp"
+#include "scheduler.hpp"
+#include <optional>
 #include <ranges>
 #include <tuple>
 #include <vector>
@@ -33,7 +35,7 @@ template <typename... Ts> struct select_tuple_awaitor {
 		for_each([&](auto && promise) { promise.handle.promise().add_awaiting(awaiting); });
 
 		// ask scheduler what to do next, this will be awaken when some of the coroutines is finished...
-		return h.promise().scheduler.suspend();
+		return h.promise().scheduler.suspend(h);
 	}
 
 	template <size_t Idx = 0> auto recursive_get() -> result_type {
@@ -65,6 +67,92 @@ auto select(type_is_task auto &&... promises) {
 	return co_curl::select_tuple_awaitor<decltype(promises)...>(std::forward<decltype(promises)>(promises)...);
 }
 
+// suspends until any of the promises is finished (true) or the deadline passed (false), promises are not consumed
+template <typename... Ts> struct wait_any_awaiter {
+	using clock = sleeping_coroutines::clock;
+
+	std::tuple<Ts &...> promises;
+	std::optional<clock::time_point> deadline{};
+	sleeping_coroutines * timers{nullptr};
+	sleeping_coroutines::iterator position{};
+	std::coroutine_handle<> awaiting{};
+
+	static constexpr auto index = std::make_index_sequence<sizeof...(Ts)>();
+
+	wait_any_awaiter(std::optional<clock::time_point> dl, Ts &... ps) noexcept: promises{ps...}, deadline{dl} { }
+	wait_any_awaiter(const wait_any_awaiter &) = delete;
+	wait_any_awaiter(wait_any_awaiter && other) noexcept: promises{other.promises}, deadline{other.deadline}, timers{std::exchange(other.timers, nullptr)}, position{other.position}, awaiting{std::exchange(other.awaiting, nullptr)} { }
+	wait_any_awaiter & operator=(const wait_any_awaiter &) = delete;
+	wait_any_awaiter & operator=(wait_any_awaiter &&) = delete;
+
+	// coroutine destroyed while waiting
+	~wait_any_awaiter() noexcept {
+		unregister(true);
+	}
+
+	template <typename CB> void for_each(CB && cb) {
+		[&]<size_t... Idx>(std::index_sequence<Idx...>) { ((void)cb(std::get<Idx>(promises)), ...); }(index);
+	}
+
+	bool any_done() const noexcept {
+		return [&]<size_t... Idx>(std::index_sequence<Idx...>) { return (std::get<Idx>(promises).handle.done() || ... || false); }(index);
+	}
+
+	bool await_ready() const noexcept {
+		return any_done();
+	}
+
+	// deadline is compared with scheduler's clock (it can be a virtual one)
+	template <typename R, typename Scheduler> auto await_suspend(std::coroutine_handle<co_curl::promise_type<R, Scheduler>> h) -> std::coroutine_handle<> {
+		if (deadline && *deadline <= h.promise().scheduler.now()) {
+			return h;
+		}
+
+		awaiting = h;
+		for_each([&](auto & promise) { promise.handle.promise().add_awaiting(awaiting); });
+
+		if (deadline) {
+			timers = &h.promise().scheduler.timers;
+			return h.promise().scheduler.schedule_at(h, *deadline, position);
+		}
+
+		return h.promise().scheduler.suspend(h);
+	}
+
+	bool await_resume() noexcept {
+		// when nothing is finished we were woken up by the timer which is already removed
+		unregister(any_done());
+		return any_done();
+	}
+
+	void unregister(bool timer_is_registered) noexcept {
+		if (!awaiting) {
+			return;
+		}
+
+		for_each([&](auto & promise) {
+			if (!promise.handle.done()) {
+				promise.handle.promise().remove_awaiting(awaiting);
+			}
+		});
+
+		if (timers && timer_is_registered) {
+			timers->remove(position);
+		}
+
+		timers = nullptr;
+		awaiting = nullptr;
+	}
+};
+
+template <typename... Ts> auto wait_any(Ts &... promises) noexcept {
+	return wait_any_awaiter<Ts...>(std::nullopt, promises...);
+}
+
+template <typename... Ts> auto wait_any_until(sleeping_coroutines::clock::time_point deadline, Ts &... promises) noexcept {
+	return wait_any_awaiter<Ts...>(deadline, promises...);
+}
+
 } // namespace co_curl
 
 #endif
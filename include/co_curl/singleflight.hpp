@@ -0,0 +1,160 @@
+#ifndef CO_CURL_SINGLEFLIGHT_HPP
+#define CO_CURL_SINGLEFLIGHT_HPP
+
+#include "fetch.hpp"
+#include "promise.hpp"
+#include "response_cache.hpp"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace co_curl {
+
+// identity of a request for coalescing, two requests with equal keys are expected to give the same response
+struct request_key {
+	std::string method{"GET"};
+	std::string url{};
+	std::vector<std::string> headers{}; // only headers which change the response, sorted
+
+	bool operator==(const request_key &) const = default;
+
+	// keeps only `selected` headers (like Accept or Authorization), names are compared case-insensitively
+	static auto from(std::string_view method, std::string_view url, std::span<const std::string> headers = {}, std::span<const std::string_view> selected = {}) -> request_key {
+		constexpr auto lower = [](char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; };
+
+		request_key output{.method = std::string(method), .url = response_cache::normalize(url)};
+
+		for (const std::string & header: headers) {
+			const auto name = std::string_view(header).substr(0, header.find(':'));
+
+			if (std::ranges::any_of(selected, [&](std::string_view s) { return std::ranges::equal(s, name, {}, lower, lower); })) {
+				output.headers.push_back(header);
+			}
+		}
+
+		std::ranges::sort(output.headers);
+		return output;
+	}
+};
+
+} // namespace co_curl
+
+template <> struct std::hash<co_curl::request_key> {
+	size_t operator()(const co_curl::request_key & key) const noexcept {
+		const auto combine = [](size_t seed, size_t value) { return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6u) + (seed >> 2u)); };
+
+		size_t seed = combine(std::hash<std::string>{}(key.method), std::hash<std::string>{}(key.url));
+
+		for (const std::string & header: key.headers) {
+			seed = combine(seed, std::hash<std::string>{}(header));
+		}
+
+		return seed;
+	}
+};
+
+namespace co_curl {
+
+struct singleflight_stats {
+	size_t started{0};
+	size_t joined{0};
+};
+
+// concurrent calls with the same key share one in-flight coroutine, everyone gets a copy of its result (or its exception)
+// (use a shared pointer as the result type when the result is big)
+template <typename R, typename Key = request_key, typename Hash = std::hash<Key>> struct singleflight {
+	using shared_type = std::shared_ptr<co_curl::promise<R>>;
+
+	std::unordered_map<Key, shared_type, Hash> in_flight{};
+	singleflight_stats stats{};
+
+	// awaiting the shared coroutine, unregisters itself when the awaiting coroutine is destroyed
+	struct shared_awaiter {
+		shared_type shared;
+		std::coroutine_handle<> waiting{};
+
+		explicit shared_awaiter(shared_type s) noexcept: shared{std::move(s)} { }
+		shared_awaiter(const shared_awaiter &) = delete;
+		shared_awaiter(shared_awaiter && other) noexcept: shared{std::move(other.shared)}, waiting{std::exchange(other.waiting, nullptr)} { }
+		shared_awaiter & operator=(const shared_awaiter &) = delete;
+		shared_awaiter & operator=(shared_awaiter &&) = delete;
+
+		~shared_awaiter() noexcept {
+			if (shared && waiting && !shared->handle.done()) {
+				shared->handle.promise().remove_awaiting(waiting);
+			}
+		}
+
+		bool await_ready() const noexcept {
+			return shared->handle.done();
+		}
+
+		template <typename T> auto await_suspend(std::coroutine_handle<T> awaiter) {
+			waiting = awaiter;
+			return shared->handle.promise().someone_is_waiting_on_me(awaiter);
+		}
+
+		decltype(auto) await_resume() {
+			waiting = nullptr;
+			return shared->handle.promise().result.cref();
+		}
+	};
+
+	// forgets the key when it's finished, or when the last interested coroutine is gone (which cancels the transfer)
+	struct leave_guard {
+		singleflight & owner;
+		const Key & key;
+		const shared_type & shared;
+
+		~leave_guard() noexcept {
+			const auto it = owner.in_flight.find(key);
+
+			if (it == owner.in_flight.end() || it->second != shared) {
+				return;
+			}
+
+			// one reference is ours and one is in the map
+			if (shared->handle.done() || shared.use_count() <= 2) {
+				owner.in_flight.erase(it);
+			}
+		}
+	};
+
+	// `start` is called only when there is no transfer with the same key in flight
+	template <typename F> requires(std::is_invocable_r_v<co_curl::promise<R>, F &>) auto operator()(Key key, F start) -> co_curl::promise<R> {
+		auto it = in_flight.find(key);
+
+		shared_type shared{};
+
+		if (it == in_flight.end()) {
+			++stats.started;
+			shared = std::make_shared<co_curl::promise<R>>(start());
+			in_flight.emplace(key, shared);
+		} else {
+			++stats.joined;
+			shared = it->second;
+		}
+
+		const auto guard = leave_guard{*this, key, shared};
+
+		co_return co_await shared_awaiter{shared};
+	}
+
+	bool empty() const noexcept {
+		return in_flight.empty();
+	}
+};
+
+// concurrent fetches of the same URL are done by one transfer
+template <typename Container = std::string> auto fetch(singleflight<Container> & flights, std::string url, int attempts = 5) -> co_curl::promise<Container> {
+	co_return co_await flights(request_key::from("GET", url), [&] { return fetch<Container>(url, attempts); });
+}
+
+} // namespace co_curl
+
+#endif
@@ -0,0 +1,217 @@
+#include "snapshot.hpp"
+#include "progress.hpp"
+#include "url.hpp"
+#include <future>
+#include <memory>
+#include <sstream>
+#include <curl/curl.h>
+
+auto co_curl::to_string(wait_reason reason) noexcept -> std::string_view {
+	switch (reason) {
+	case wait_reason::transfer: return "transfer";
+	case wait_reason::queued_transfer: return "queued_transfer";
+	case wait_reason::timer: return "timer";
+	case wait_reason::coroutine: return "coroutine";
+	case wait_reason::progress: return "progress";
+	case wait_reason::ready: return "ready";
+	}
+
+	return "unknown";
+}
+
+static auto describe_transfer(co_curl::transfer_bookkeeping & waiting, CURL * handle) -> co_curl::transfer_snapshot {
+	auto out = co_curl::transfer_snapshot{.handle = handle};
+
+	const char * url = nullptr;
+
+	if (CURLE_OK == curl_easy_getinfo(handle, CURLINFO_EFFECTIVE_URL, &url) && url) {
+		out.url = url;
+	}
+
+	if (const auto it = waiting.transfers.find(handle); it != waiting.transfers.end()) {
+		out.host = it->second.host;
+		out.queued = it->second.queued;
+	} else if (!out.url.empty()) {
+		out.host = co_curl::url{out.url.c_str()}.host().value_or(std::string{});
+	}
+
+	curl_off_t bytes{0};
+
+	if (CURLE_OK == curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &bytes) && bytes > 0) {
+		out.downloaded = static_cast<size_t>(bytes);
+	}
+
+	if (CURLE_OK == curl_easy_getinfo(handle, CURLINFO_SIZE_UPLOAD_T, &bytes) && bytes > 0) {
+		out.uploaded = static_cast<size_t>(bytes);
+	}
+
+	void * coroutine = nullptr;
+	curl_easy_getinfo(handle, CURLINFO_PRIVATE, &coroutine);
+	out.coroutine = coroutine;
+
+	if (const auto it = waiting.bandwidth.transfers.find(handle); it != waiting.bandwidth.transfers.end()) {
+		out.group = it->second.group;
+		out.weight = it->second.weight;
+	}
+
+	return out;
+}
+
+auto co_curl::take_snapshot(default_scheduler & scheduler) -> scheduler_snapshot {
+	using clock = std::chrono::steady_clock;
+
+	// same clock as timers and transfers use (it can be simulated)
+	const auto now = scheduler.now();
+	auto & waiting = scheduler.waiting;
+
+	auto out = scheduler_snapshot{.running_transfers = waiting.running, .ready = scheduler.ready.data.size() + waiting.woken.size()};
+
+	const auto add_coroutine = [&](const void * coroutine, wait_reason reason, const void * awaits = nullptr, std::chrono::milliseconds wakes_in = {}) {
+		out.coroutines.push_back(coroutine_snapshot{.coroutine = coroutine, .label = std::string(scheduler.lag.label_of(coroutine)), .reason = reason, .awaits = awaits, .wakes_in = wakes_in});
+	};
+
+	for (const auto & [handle, since]: waiting.introspection.running_since) {
+		auto & t = out.transfers.emplace_back(describe_transfer(waiting, handle));
+		t.age = std::chrono::duration_cast<std::chrono::milliseconds>(now - since);
+		add_coroutine(t.coroutine, wait_reason::transfer, handle);
+	}
+
+	for (const auto & [host, limit]: waiting.limits.hosts) {
+		for (const queued_transfer & q: limit.queue) {
+			auto & t = out.transfers.emplace_back(describe_transfer(waiting, q.handle->native_handle));
+			t.queued = true;
+			t.coroutine = q.coroutine.address();
+			add_coroutine(t.coroutine, wait_reason::queued_transfer, t.handle);
+		}
+	}
+
+	for (const auto & [deadline, coroutine]: scheduler.timers.data) {
+		add_coroutine(coroutine.address(), wait_reason::timer, nullptr, std::chrono::ceil<std::chrono::milliseconds>(std::max(deadline - now, clock::duration{})));
+	}
+
+	for (const auto & [awaited, awaiter]: waiting.introspection.awaited_by) {
+		add_coroutine(awaiter, wait_reason::coroutine, awaited);
+	}
+
+	for (const auto & [awaited, awaiter]: scheduler.waiting_for_someone_else) {
+		add_coroutine(awaiter.address(), wait_reason::coroutine, awaited.address());
+	}
+
+	for (const auto & [handle, stream]: waiting.streams) {
+		if (stream->awaiting && !stream->woken) {
+			add_coroutine(stream->awaiting.address(), wait_reason::progress, handle);
+		}
+	}
+
+	for (auto ready = scheduler.ready.data; !ready.empty(); ready.pop()) {
+		add_coroutine(ready.front().address(), wait_reason::ready);
+	}
+
+	for (const auto coroutine: waiting.woken) {
+		add_coroutine(coroutine.address(), wait_reason::ready);
+	}
+
+	return out;
+}
+
+auto co_curl::request_snapshot(std::chrono::milliseconds timeout, default_scheduler & scheduler) -> std::optional<scheduler_snapshot> {
+	auto result = std::make_shared<std::promise<scheduler_snapshot>>();
+	auto future = result->get_future();
+
+	scheduler.waiting.post([result, &scheduler] {
+		try {
+			result->set_value(take_snapshot(scheduler));
+		} catch (...) {
+			result->set_exception(std::current_exception());
+		}
+	});
+
+	if (future.wait_for(timeout) != std::future_status::ready) {
+		return std::nullopt;
+	}
+
+	return future.get();
+}
+
+static void write_pointer(std::ostream & os, const void * ptr) {
+	if (ptr) {
+		os << '"' << ptr << '"';
+	} else {
+		os << "null";
+	}
+}
+
+static void write_string(std::ostream & os, std::string_view str) {
+	os << '"';
+
+	for (const char c: str) {
+		switch (c) {
+		case '"': os << "\\\""; break;
+		case '\\': os << "\\\\"; break;
+		case '\n': os << "\\n"; break;
+		case '\r': os << "\\r"; break;
+		case '\t': os << "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20u) {
+				constexpr auto hex = std::string_view{"0123456789abcdef"};
+				os << "\\u00" << hex[static_cast<unsigned char>(c) >> 4u] << hex[static_cast<unsigned char>(c) & 0xFu];
+			} else {
+				os << c;
+			}
+		}
+	}
+
+	os << '"';
+}
+
+auto co_curl::scheduler_snapshot::to_json() const -> std::string {
+	std::ostringstream os{};
+
+	os << R"({"running_transfers":)" << running_transfers << R"(,"ready":)" << ready << R"(,"transfers":[)";
+
+	for (bool first = true; const transfer_snapshot & t: transfers) {
+		os << (std::exchange(first, false) ? "" : ",") << R"({"url":)";
+		write_string(os, t.url);
+		os << R"(,"host":)";
+		write_string(os, t.host);
+		os << R"(,"age_ms":)" << t.age.count() << R"(,"downloaded":)" << t.downloaded << R"(,"uploaded":)" << t.uploaded;
+		os << R"(,"queued":)" << (t.queued ? "true" : "false") << R"(,"handle":)";
+		write_pointer(os, t.handle);
+		os << R"(,"coroutine":)";
+		write_pointer(os, t.coroutine);
+
+		if (t.group) {
+			os << R"(,"group":)";
+			write_string(os, *t.group);
+			os << R"(,"weight":)" << t.weight;
+		}
+
+		os << '}';
+	}
+
+	os << R"(],"coroutines":[)";
+
+	for (bool first = true; const coroutine_snapshot & c: coroutines) {
+		os << (std::exchange(first, false) ? "" : ",") << R"({"coroutine":)";
+		write_pointer(os, c.coroutine);
+
+		if (!c.label.empty()) {
+			os << R"(,"label":)";
+			write_string(os, c.label);
+		}
+
+		os << R"(,"waits_for":)";
+		write_string(os, to_string(c.reason));
+		os << R"(,"awaits":)";
+		write_pointer(os, c.awaits);
+
+		if (c.reason == wait_reason::timer) {
+			os << R"(,"wakes_in_ms":)" << c.wakes_in.count();
+		}
+
+		os << '}';
+	}
+
+	os << "]}";
+	return std::move(os).str();
+}
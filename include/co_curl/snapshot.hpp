@@ -0,0 +1,65 @@
+#ifndef CO_CURL_SNAPSHOT_HPP
+#define CO_CURL_SNAPSHOT_HPP
+
+#include "scheduler.hpp"
+#include <optional>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+
+namespace co_curl {
+
+struct transfer_snapshot {
+	std::string url{};
+	std::string host{};
+	std::chrono::milliseconds age{}; // zero for queued transfers
+	size_t downloaded{0};
+	size_t uploaded{0};
+	const void * handle{nullptr};
+	const void * coroutine{nullptr};
+	bool queued{false}; // waiting for a free slot of its host
+
+	// bandwidth group and weight when the transfer is shaped
+	std::optional<std::string> group{};
+	double weight{1.0};
+};
+
+enum class wait_reason { transfer, queued_transfer, timer, coroutine, progress, ready };
+
+struct coroutine_snapshot {
+	const void * coroutine{nullptr};
+	std::string label{};
+	wait_reason reason{};
+
+	// the awaited coroutine or easy handle
+	const void * awaits{nullptr};
+
+	// only for timers
+	std::chrono::milliseconds wakes_in{};
+};
+
+struct scheduler_snapshot {
+	std::vector<transfer_snapshot> transfers{};
+	std::vector<coroutine_snapshot> coroutines{};
+	unsigned running_transfers{0};
+	size_t ready{0};
+
+	auto to_json() const -> std::string;
+};
+
+auto to_string(wait_reason reason) noexcept -> std::string_view;
+
+// running transfers and coroutines awaiting other coroutines are listed only when the scheduler's introspection is
+// enabled (`get_scheduler().get_introspection().enabled = true`) since they were started
+
+// must be called on the thread running the scheduler (eg. from a coroutine)
+auto take_snapshot(default_scheduler & scheduler = get_scheduler()) -> scheduler_snapshot;
+
+// from any other thread: the snapshot is taken by the loop next time it waits for transfers, nothing when the loop
+// doesn't get there in time (it's busy running a coroutine or it's not running at all)
+auto request_snapshot(std::chrono::milliseconds timeout, default_scheduler & scheduler = get_scheduler()) -> std::optional<scheduler_snapshot>;
+
+} // namespace co_curl
+
+#endif
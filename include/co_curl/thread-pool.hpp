@@ -1,10 +1,12 @@
 #ifndef CO_CURL_THREAD_POOL_HPP
 #define CO_CURL_THREAD_POOL_HPP
 
+#include "probes.hpp"
 #include <atomic>
 #include <functional>
 #include <future>
 #include <iostream>
+#include <optional>
 #include <queue>
 #include <thread>
 #include <utility>
@@ -49,10 +51,12 @@ struct thread_pool {
 
 		auto res = std::move(queue.front());
 		queue.pop();
+		CO_CURL_PROBE1(pool_get_next, res.address());
 		return res;
 	}
 
 	void add(std::coroutine_handle<> handle) {
+		CO_CURL_PROBE1(pool_add, handle.address());
 		auto lock = std::unique_lock(mutex);
 		queue.emplace(handle);
 		cv.notify_one();
@@ -173,7 +177,7 @@ template <typename R> struct detached_promise_type {
 	std::coroutine_handle<> awaiter{};
 	result_or_exception<R> result{};
 
-	explicit detached_promise_type(thread_pool & t) noexcept: pool{t} { }
+	explicit detached_promise_type(thread_pool & t, auto &&...) noexcept: pool{t} { }
 
 	auto initial_suspend() {
 		return schedule_at_threadpool{};
@@ -205,7 +209,7 @@ template <> struct detached_promise_type<void> {
 	std::coroutine_handle<> awaiter{};
 	result_or_exception<void> result{};
 
-	explicit detached_promise_type(thread_pool & t) noexcept: pool{t} { }
+	explicit detached_promise_type(thread_pool & t, auto &&...) noexcept: pool{t} { }
 
 	auto initial_suspend() {
 		return schedule_at_threadpool{};
@@ -267,15 +271,54 @@ template <typename R> struct detached_task {
 	}
 };
 
+// fire-and-forget job running on a thread_pool, nobody awaits it and its frame is destroyed when it finishes
+struct pool_job {
+	struct promise_type {
+		thread_pool & pool;
+
+		explicit promise_type(thread_pool & t, auto &&...) noexcept: pool{t} { }
+
+		auto initial_suspend() {
+			return schedule_at_threadpool{};
+		}
+
+		auto final_suspend() noexcept {
+			return std::suspend_never{};
+		}
+
+		void return_void() noexcept { }
+
+		void unhandled_exception() noexcept {
+			std::terminate();
+		}
+
+		auto get_return_object() noexcept {
+			return pool_job{};
+		}
+	};
+};
+
 template <typename T> struct sync_awaiter {
 	struct promise_type {
 		std::promise<T> result;
+		std::optional<T> value{};
+
+		// result is published only after this coroutine is suspended, otherwise the waiting thread could destroy
+		// its frame (and the awaited task) while the pool's thread is still running it
+		struct publish_result {
+			bool await_ready() const noexcept { return false; }
+			void await_resume() const noexcept { }
+
+			void await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+				h.promise().result.set_value(std::move(*h.promise().value));
+			}
+		};
 
 		auto initial_suspend() { return std::suspend_never{}; }
-		auto final_suspend() noexcept { return std::suspend_always{}; }
+		auto final_suspend() noexcept { return publish_result{}; }
 
-		void return_value(T value) noexcept {
-			result.set_value(value);
+		void return_value(T v) noexcept {
+			value.emplace(std::move(v));
 		}
 
 		void unhandled_exception() noexcept {
@@ -304,11 +347,11 @@ template <typename T> struct sync_awaiter {
 };
 
 template <typename T> auto sync_await(detached_task<T> && task) {
-	return [&]() -> sync_awaiter<T> { co_return co_await task; }().get_result();
+	return [](detached_task<T> & t) -> sync_awaiter<T> { co_return co_await t; }(task).get_result();
 }
 
 template <typename T> auto sync_await(detached_task<T> & task) {
-	return [&]() -> sync_awaiter<T> { co_return co_await task; }().get_result();
+	return [](detached_task<T> & t) -> sync_awaiter<T> { co_return co_await t; }(task).get_result();
 }
 
 } // namespace co_curl
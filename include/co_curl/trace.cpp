@@ -0,0 +1,141 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <charconv>
+#include <chrono>
+
+namespace {
+
+struct trace_registry {
+	std::mutex mutex{};
+	std::vector<std::unique_ptr<co_curl::trace_ring>> rings{};
+
+	auto create() -> co_curl::trace_ring * {
+		auto ring = std::make_unique<co_curl::trace_ring>();
+
+		const auto lock = std::lock_guard{mutex};
+		ring->thread = static_cast<unsigned>(rings.size()) + 1u;
+		rings.push_back(std::move(ring));
+		return rings.back().get();
+	}
+};
+
+auto registry() -> trace_registry & {
+	// rings are never released so threads can exit before the trace is written
+	static auto * instance = new trace_registry{};
+	return *instance;
+}
+
+thread_local co_curl::trace_ring * local_ring = nullptr;
+
+struct recorded_event {
+	co_curl::trace_event event;
+	unsigned thread;
+};
+
+void write_id(std::ostream & out, const void * ptr) {
+	std::array<char, 2u * sizeof(std::uintptr_t)> buffer{};
+	const auto r = std::to_chars(buffer.data(), buffer.data() + buffer.size(), reinterpret_cast<std::uintptr_t>(ptr), 16);
+	out << "\"0x" << std::string_view(buffer.data(), r.ptr) << '"';
+}
+
+void write_event(std::ostream & out, bool & first, const recorded_event & rec, std::uint64_t start_ns, const char * name, char phase) {
+	out << (first ? "\n" : ",\n");
+	first = false;
+
+	const auto us = static_cast<double>(rec.event.timestamp_ns - start_ns) / 1000.0;
+
+	out << R"({"name":")" << name << R"(","cat":"coroutine","ph":")" << phase << R"(","id":)";
+	write_id(out, rec.event.subject);
+	out << R"(,"pid":1,"tid":)" << rec.thread << R"(,"ts":)" << us;
+
+	if (rec.event.kind == co_curl::trace_kind::transfer_added) {
+		out << R"(,"args":{"handle":)";
+		write_id(out, rec.event.related);
+		out << '}';
+	} else if (rec.event.kind == co_curl::trace_kind::transfer_completed) {
+		out << R"(,"args":{"result":)" << rec.event.value << '}';
+	}
+
+	out << '}';
+}
+
+} // namespace
+
+void co_curl::record_trace_event(trace_kind kind, const void * subject, const void * related, std::int32_t value) noexcept {
+	if (!local_ring) {
+		try {
+			local_ring = registry().create();
+		} catch (...) {
+			return;
+		}
+	}
+
+	const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch());
+
+	local_ring->push(trace_event{.timestamp_ns = static_cast<std::uint64_t>(now.count()), .subject = subject, .related = related, .value = value, .kind = kind});
+}
+
+void co_curl::write_chrome_trace(std::ostream & out) {
+	std::vector<recorded_event> events{};
+
+	{
+		auto & reg = registry();
+		const auto lock = std::lock_guard{reg.mutex};
+
+		for (const auto & ring: reg.rings) {
+			const auto written = ring->written.load(std::memory_order_acquire);
+			const auto first = (written > trace_ring::capacity) ? written - trace_ring::capacity : std::uint64_t{0};
+
+			for (auto i = first; i != written; ++i) {
+				events.push_back(recorded_event{ring->events[i % trace_ring::capacity], ring->thread});
+			}
+		}
+	}
+
+	std::ranges::stable_sort(events, {}, [](const recorded_event & r) { return r.event.timestamp_ns; });
+
+	const std::uint64_t start_ns = events.empty() ? 0u : events.front().event.timestamp_ns;
+
+	out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+
+	bool first = true;
+
+	for (const recorded_event & rec: events) {
+		switch (rec.event.kind) {
+		case trace_kind::task_created:
+			write_event(out, first, rec, start_ns, "task", 'b');
+			write_event(out, first, rec, start_ns, "running", 'b');
+			break;
+		case trace_kind::task_suspended:
+			write_event(out, first, rec, start_ns, "running", 'e');
+			break;
+		case trace_kind::task_resumed:
+			write_event(out, first, rec, start_ns, "running", 'b');
+			break;
+		case trace_kind::task_finished:
+			write_event(out, first, rec, start_ns, "running", 'e');
+			write_event(out, first, rec, start_ns, "task", 'e');
+			break;
+		case trace_kind::transfer_added:
+			write_event(out, first, rec, start_ns, "transfer", 'b');
+			break;
+		case trace_kind::transfer_completed:
+			write_event(out, first, rec, start_ns, "transfer", 'e');
+			break;
+		}
+	}
+
+	out << "\n]}\n";
+}
+
+void co_curl::clear_trace() noexcept {
+	auto & reg = registry();
+	const auto lock = std::lock_guard{reg.mutex};
+
+	for (const auto & ring: reg.rings) {
+		ring->written.store(0u, std::memory_order_release);
+	}
+}
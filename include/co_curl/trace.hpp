@@ -0,0 +1,69 @@
+#ifndef CO_CURL_TRACE_HPP
+#define CO_CURL_TRACE_HPP
+
+#include <array>
+#include <atomic>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+
+namespace co_curl {
+
+// build with CO_CURL_TRACING (cmake option of the same name) to record lifetimes of coroutines and transfers,
+// otherwise all trace points compile to nothing
+#ifdef CO_CURL_TRACING
+inline constexpr bool tracing_enabled = true;
+#else
+inline constexpr bool tracing_enabled = false;
+#endif
+
+enum class trace_kind : std::uint8_t {
+	task_created,
+	task_suspended,
+	task_resumed,
+	task_finished,
+	transfer_added,     // subject is the awaiting coroutine, related is the easy handle
+	transfer_completed, // subject is the awaiting coroutine, related is the easy handle, value is the result
+};
+
+struct trace_event {
+	std::uint64_t timestamp_ns{0};
+	const void * subject{nullptr};
+	const void * related{nullptr};
+	std::int32_t value{0};
+	trace_kind kind{};
+};
+
+// each thread records into its own ring, only the newest `capacity` events are kept
+struct trace_ring {
+	static constexpr size_t capacity = size_t{1} << 16u;
+
+	std::array<trace_event, capacity> events{};
+	std::atomic<std::uint64_t> written{0};
+	unsigned thread{0};
+
+	void push(const trace_event & ev) noexcept {
+		const auto n = written.load(std::memory_order_relaxed);
+		events[n % capacity] = ev;
+		written.store(n + 1u, std::memory_order_release);
+	}
+};
+
+void record_trace_event(trace_kind kind, const void * subject, const void * related, std::int32_t value) noexcept;
+
+inline void trace(trace_kind kind, const void * subject, const void * related = nullptr, std::int32_t value = 0) noexcept {
+	if constexpr (tracing_enabled) {
+		record_trace_event(kind, subject, related, value);
+	}
+}
+
+// Chrome trace event JSON (chrome://tracing, Perfetto UI): every coroutine is an async track with "running" slices,
+// its transfers are nested spans, dump it when threads are not recording (events being overwritten could be torn)
+void write_chrome_trace(std::ostream & out);
+
+// forget recorded events of all threads
+void clear_trace() noexcept;
+
+} // namespace co_curl
+
+#endif
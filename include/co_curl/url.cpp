@@ -38,6 +38,11 @@ co_curl::url & co_curl::url::set_scheme(const char * cstr) {
 	return *this;
 }
 
+co_curl::url & co_curl::url::set_host(const char * cstr) {
+	curl_url_set(handle, CURLUPART_HOST, cstr, 0);
+	return *this;
+}
+
 static std::optional<std::string> get_url_as_string(CURLU * handle, CURLUPart part) {
 	char * ptr{nullptr};
 	curl_url_get(handle, part, &ptr, 0);
@@ -46,7 +51,9 @@ static std::optional<std::string> get_url_as_string(CURLU * handle, CURLUPart pa
 		return std::nullopt;
 	}
 
-	return std::string{ptr};
+	auto output = std::string{ptr};
+	curl_free(ptr);
+	return output;
 }
 
 std::optional<std::string> co_curl::url::get() const {
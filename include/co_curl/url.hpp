@@ -22,6 +22,7 @@ struct url {
 	url & remove_query();
 
 	url & set_scheme(const char * proto);
+	url & set_host(const char * host);
 
 	url & operator=(const char * cstr);
 